@@ -0,0 +1,40 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+// Work items of a batch handed out in index order, each admitted only while the estimated memory of the running items
+// fits the budget. An item that does not fit is passed over for a later one that does, so small files keep flowing
+// around a large one; an item larger than the whole budget is admitted once nothing else is running
+class AdmissionQueue {
+public:
+    // Constructor that takes the estimated peak memory of each item, a budget of 0 admits everything
+    AdmissionQueue(std::vector<uintmax_t> memoryEstimates, uintmax_t memoryBudget);
+
+    // Disable copy semantics
+    AdmissionQueue(const AdmissionQueue&) = delete;
+    AdmissionQueue& operator=(const AdmissionQueue&) = delete;
+
+    // Take the first waiting item that fits, waiting for running items to finish if none does.
+    // Returns nullopt once every item was taken
+    std::optional<size_t> take();
+
+    // Charge a running item a larger estimate, once it is known to need more memory than it was admitted with.
+    // The item is not held back, the items after it are admitted against the new estimate
+    void raise(size_t item, uintmax_t memoryEstimate);
+
+    // Return the memory of a finished item to the budget
+    void release(size_t item);
+
+private:
+    std::mutex mutex_;
+    std::condition_variable released_;
+    std::vector<uintmax_t> memoryEstimates_;
+    std::vector<size_t> waiting_;
+    uintmax_t memoryBudget_;
+    uintmax_t memoryInUse_ = 0;
+    size_t running_ = 0;
+};
@@ -0,0 +1,16 @@
+#pragma once
+#include <filesystem>
+#include <vector>
+
+#include "ri_conversion_session.h"
+#include "ri_database.h"
+#include "ri_logger.h"
+#include "ri_options.h"
+#include "ri_run_report.h"
+
+// Function to convert the refr_index values of a single .ESP|ESM file and add it to the run report
+void convertPluginFile(ConversionSession& session, const Database& db, RunReport& runReport);
+
+// Function to convert all input files, spread over a pool of workers when several jobs are requested
+void convertPluginFiles(const std::vector<std::filesystem::path>& inputPaths, const Database& db,
+    const ProgramOptions& options, LogSink& logFile, RunReport& runReport);
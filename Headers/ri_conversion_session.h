@@ -0,0 +1,37 @@
+#pragma once
+#include <cstddef>
+#include <filesystem>
+#include <unordered_set>
+
+#include "ri_logger.h"
+#include "ri_mismatches.h"
+#include "ri_options.h"
+#include "ri_replacement_report.h"
+#include "ri_run_report.h"
+
+// State of the conversion of a single .ESP|ESM file, passed to every step of the conversion
+// instead of global data, so any number of files can be converted at the same time
+struct ConversionSession {
+    ConversionSession(const std::filesystem::path& pluginPath, const ProgramOptions& options, LogSink& logFile)
+        : pluginPath(pluginPath), options(options), logFile(logFile) {}
+
+    const std::filesystem::path pluginPath;
+    const ProgramOptions& options;
+    LogSink& logFile;
+
+    // Validation and mismatch tracking
+    std::unordered_set<int> validMastersIn;               // Valid master indices from input
+    std::unordered_set<int> validMastersDb;               // Valid master indices from database
+    std::unordered_set<MismatchEntry> mismatchedEntries;  // Collection of mismatched records
+    int mismatchChoice = 0;                               // 0 - not asked yet, 1 - replace, 2 - keep
+
+    // Counters
+    size_t replacements = 0;  // Replaced refr_index values, including replaced mismatches
+    size_t mismatches = 0;    // References whose id differs from the database
+
+    // Per-reference detail in summary mode
+    ReplacementReport report;
+
+    // Step timings and sizes for the run report
+    FileMetrics metrics;
+};
@@ -1,29 +1,68 @@
 #pragma once
-#include <unordered_set>
+#include <cstddef>
 #include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <utility>
+#include <vector>
 
+#include "ri_conversion_session.h"
 #include "ri_database.h"
-#include "ri_mismatches.h"
-#include "ri_options.h"
 
-// Define an enumeration for fetch modes
-enum FetchMode {
-    FETCH_DB_ID,
-    FETCH_OPPOSITE_REFR_INDEX
+// Result of a refr_index lookup for one reference
+struct RefrIndexLookup {
+    std::optional<int> refrIndex;  // Target of the row with the same refr_index and id
+    int refrIndexDb = -1;          // Target of the first row with the same refr_index allowed by the master filter
+    std::string idDb;              // ID of that row
+    bool queried = false;          // Answered by an SQLite query, not by the in-memory table
+
+    // Add a candidate row, rows must come in table order; returns true once later rows cannot change the result
+    bool addRow(int target, std::string_view id, int master, std::string_view idJson, int masterFilter);
 };
 
-// Function to fetch the refr_index from the database
-std::optional<int> fetchRefIndex(const Database& db, const std::string& query,
-    int refrIndexJson, const std::string& idJson);
+// Files with fewer cells or references are looked up on a single thread
+constexpr size_t MIN_PARALLEL_CELLS = 64;
+constexpr size_t MIN_PARALLEL_REFERENCES = 16384;
+
+// Mismatched references with their entries in the mismatch set, in file order
+using MismatchedReferences = std::vector<std::pair<ordered_json*, const MismatchEntry*>>;
+
+// Function to determine which master the database lookup is limited to (0 - none, 2 - Tribunal, 3 - Bloodmoon)
+int getMasterFilter(int mastIndex, const std::unordered_set<int>& validMastersDb);
+
+// Function to look up the replacement and the mismatch candidate of a reference with a single query
+RefrIndexLookup lookupRefrIndex(const Database& db, int conversionChoice, int refrIndexJson,
+    const std::string& idJson, int masterFilter);
+
+// Function to check whether any reference has a replacement or mismatch in the database
+bool hasConvertibleReferences(const Database& db, const ordered_json& inputData, ConversionSession& session);
 
-// Template function to fetch ID from the database based on the fetch mode
-template <FetchMode mode>
-auto fetchID(const Database& db, int refrIndexJson, int mastIndex,
-    const std::unordered_set<int>& validMastersDb, int conversionChoice);
+// Function to get the references array of a cell, nullptr for other records
+const ordered_json* getCellReferences(const ordered_json& cell);
+
+// Function to check whether a reference is looked up: it has a numeric refr_index, a string id and a valid master
+bool isLookupCandidate(const ordered_json& referenceData, const ConversionSession& session);
+
+// Function to look up the references of a single cell without changing anything, in reference order
+void lookupCellReferences(const Database& db, const ConversionSession& session, const ordered_json& cell,
+    std::vector<RefrIndexLookup>& lookups);
+
+// Function to look up the references of a single cell, recording its mismatched references.
+// Lookups made in advance by lookupCellReferences for the same cell are used instead of querying the database
+void processCellReferences(const Database& db, ConversionSession& session, ordered_json& cell,
+    MismatchedReferences& mismatchedReferences, std::vector<RefrIndexLookup>* lookups = nullptr);
+
+// Function to replace the refr_index of the recorded mismatched references
+void applyMismatchReplacements(ConversionSession& session, const MismatchedReferences& mismatchedReferences);
+
+// Function to look up the references of all cells on several threads, each taking a contiguous range of cells with
+// about the same number of references. Returns the lookups of each cell, or nothing if the file is looked up serially
+std::vector<std::vector<RefrIndexLookup>> lookupCellsInParallel(const Database& db, const ConversionSession& session,
+    const ordered_json& inputData);
 
 // Function to process replacements and mismatches
-int processReplacementsAndMismatches(const Database& db, const ProgramOptions& options, const std::string& query, ordered_json& inputData,
-    int conversionChoice, int& replacementsFlag,
-    const std::unordered_set<int>& validMastersDb,
-    std::unordered_set<MismatchEntry>& mismatchedEntries,
-    std::ofstream& logFile);
\ No newline at end of file
+int processReplacementsAndMismatches(const Database& db, ConversionSession& session, ordered_json& inputData);
+
+// Function to process replacements and mismatches of one streamed cell, asking for the mismatch choice at the first mismatch
+void processStreamedCell(const Database& db, ConversionSession& session, ordered_json& cell);
\ No newline at end of file
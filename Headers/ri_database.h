@@ -3,6 +3,34 @@
 #include <memory>
 #include <stdexcept>
 #include <string>
+#include <unordered_map>
+
+#include "ri_refr_index_map.h"
+
+// Key of a cached prepared statement: conversion direction
+struct StatementKey {
+    int conversionChoice;
+
+    bool operator==(const StatementKey& other) const = default;
+};
+
+// Resets a statement and clears its bindings when leaving the scope of its use, so a connection does not hold
+// a read transaction open between lookups
+class StatementReset {
+public:
+    explicit StatementReset(sqlite3_stmt* stmt) : stmt_(stmt) {}
+    ~StatementReset() {
+        sqlite3_reset(stmt_);
+        sqlite3_clear_bindings(stmt_);
+    }
+
+    // Disable copy semantics
+    StatementReset(const StatementReset&) = delete;
+    StatementReset& operator=(const StatementReset&) = delete;
+
+private:
+    sqlite3_stmt* stmt_;
+};
 
 class Database {
 public:
@@ -15,7 +43,7 @@ public:
 
     // Enable move semantics
     Database(Database&&) = default;
-    Database& operator=(Database&&) = default;
+    Database& operator=(Database&& other) noexcept;
 
     // Implicit conversion to sqlite3* for compatibility with SQLite C API
     operator sqlite3* () const { return db_.get(); }
@@ -26,6 +54,21 @@ public:
     // Check whether the database connection is valid
     bool is_valid() const { return db_ != nullptr; }
 
+    // Get a cached prepared statement, or nullptr if it was not prepared yet. Users reset it with a StatementReset
+    sqlite3_stmt* cachedStatement(const StatementKey& key) const;
+
+    // Compile the statement and store it in the cache, returns nullptr on SQL errors
+    sqlite3_stmt* prepareStatement(const StatementKey& key, const std::string& query) const;
+
+    // Load the refr_index table into memory, lookups use it instead of SQL queries afterwards
+    void loadRefrIndexMap() { refrIndexMap_ = std::make_shared<const RefrIndexMap>(db_.get()); }
+
+    // Use the in-memory table already loaded by another connection
+    void shareRefrIndexMap(const Database& other) { refrIndexMap_ = other.refrIndexMap_; }
+
+    // In-memory copy of the refr_index table, or nullptr if it was not loaded
+    const RefrIndexMap* refrIndexMap() const { return refrIndexMap_.get(); }
+
 private:
     struct Deleter {
         void operator()(sqlite3* db) const {
@@ -33,5 +76,20 @@ private:
         }
     };
 
+    struct StatementDeleter {
+        void operator()(sqlite3_stmt* stmt) const {
+            if (stmt) sqlite3_finalize(stmt);
+        }
+    };
+
+    struct StatementKeyHash {
+        size_t operator()(const StatementKey& key) const {
+            return static_cast<size_t>(key.conversionChoice);
+        }
+    };
+
+    // Statements are declared after the connection, so they are finalized before it is closed
     std::unique_ptr<sqlite3, Deleter> db_;
-};
\ No newline at end of file
+    mutable std::unordered_map<StatementKey, std::unique_ptr<sqlite3_stmt, StatementDeleter>, StatementKeyHash> statements_;
+    std::shared_ptr<const RefrIndexMap> refrIndexMap_;
+};
@@ -1,24 +1,35 @@
 #pragma once
 #include <unordered_set>
 #include <filesystem>
-#include <fstream>
+#include <optional>
 
+#include "ri_conversion_session.h"
+#include "ri_logger.h"
 #include "ri_options.h"
 
 // Function to check if file was already converted
-bool hasConversionTag(const ordered_json& inputData, const std::filesystem::path& filePath, std::ofstream& logFile);
+bool hasConversionTag(const ordered_json& inputData, const std::filesystem::path& filePath, LogSink& logFile);
 
 // Function to check the dependency order of Parent Master files in the input .ESP|ESM data
-std::pair<bool, std::unordered_set<int>> checkDependencyOrder(const ordered_json& inputData, std::ofstream& logFile);
+bool checkDependencyOrder(const ordered_json& inputData, ConversionSession& session);
+
+// Function to build the conversion tag appended to the header description
+std::string makeConversionTag(const std::string& convPrefix);
 
 // Function to add conversion tags to the header description
-bool addConversionTag(ordered_json& inputData, const std::string& convPrefix, const ProgramOptions& options, std::ofstream& logFile);
+bool addConversionTag(ordered_json& inputData, const std::string& convPrefix, const ProgramOptions& options, LogSink& logFile);
+
+// Function to create backup with automatic numbering, returns the backup path
+std::optional<std::filesystem::path> createBackup(const std::filesystem::path& filePath, const ProgramOptions& options, LogSink& logFile);
 
-// Function to create backup with automatic numbering
-bool createBackup(const std::filesystem::path& filePath, const ProgramOptions& options, std::ofstream& logFile);
+// Function to load a .JSON file: the whole file is mapped and parsed from one contiguous buffer
+std::optional<ordered_json> loadJsonFile(const std::filesystem::path& jsonPath, const ProgramOptions& options, LogSink& logFile);
 
 // Function to save the modified JSON data to file
-bool saveJsonToFile(const std::filesystem::path& jsonImportPath, const ordered_json& inputData, const ProgramOptions& options, std::ofstream& logFile);
+bool saveJsonToFile(const std::filesystem::path& jsonImportPath, const ordered_json& inputData, const ProgramOptions& options, LogSink& logFile);
+
+// Function to run tes3conv on the input file to produce the output file, its error output is logged
+bool runTes3conv(const std::filesystem::path& inputPath, const std::filesystem::path& outputPath, const ProgramOptions& options, LogSink& logFile);
 
 // Function to convert the .JSON file to .ESP|ESM
-bool convertJsonToEsp(const std::filesystem::path& jsonImportPath, const std::filesystem::path& espFilePath, const ProgramOptions& options, std::ofstream& logFile);
\ No newline at end of file
+bool convertJsonToEsp(const std::filesystem::path& jsonImportPath, const std::filesystem::path& espFilePath, const ProgramOptions& options, LogSink& logFile);
\ No newline at end of file
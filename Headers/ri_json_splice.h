@@ -0,0 +1,17 @@
+#pragma once
+#include <filesystem>
+#include <optional>
+#include <string_view>
+
+#include "ri_logger.h"
+#include "ri_options.h"
+
+// Function to scan tes3conv .JSON text for the header and the cell references without building the full DOM.
+// Produces the Header/Cell/references layout used by the converter: references carry "refr_index_offset" and
+// "refr_index_length" of their number tokens, the header carries "description_offset" and "description_length"
+std::optional<ordered_json> scanJsonReferences(std::string_view jsonText, LogSink& logFile);
+
+// Function to write the scanned .JSON text with only the changed refr_index numbers and the header description
+// replaced, using gather writes of the unchanged spans
+bool spliceJsonFile(std::string_view jsonText, const ordered_json& pluginData, const std::filesystem::path& outputPath,
+    LogSink& logFile);
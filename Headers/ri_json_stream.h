@@ -0,0 +1,12 @@
+#pragma once
+#include <filesystem>
+#include <functional>
+
+#include "ri_logger.h"
+#include "ri_options.h"
+
+// Function to rewrite a .JSON file holding a top-level array one element at a time: the SAX parser builds
+// a single element, processElement may modify it, and it is written to the output before the next one is read.
+// The output has the same layout as a whole document saved with indentation 2
+bool streamJsonArray(const std::filesystem::path& inputPath, const std::filesystem::path& outputPath,
+    const std::function<bool(ordered_json&)>& processElement, LogSink& logFile);
@@ -0,0 +1,11 @@
+#pragma once
+#include <cstddef>
+#include <filesystem>
+#include <optional>
+
+#include "ri_logger.h"
+#include "ri_options.h"
+
+// Function to write JSON data to a file in compact form, through a reusable 1 MiB buffer written in whole blocks.
+// Returns the number of bytes written
+std::optional<size_t> writeCompactJson(const std::filesystem::path& outputPath, const ordered_json& data, LogSink& logFile);
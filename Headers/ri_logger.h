@@ -1,12 +1,94 @@
 #pragma once
+#include <format>
 #include <fstream>
+#include <iterator>
 #include <string>
+#include <utility>
+
+// Severity of a log message, a sink logs the messages up to its level
+enum class LogLevel { Error, Warning, Info, Trace };
+
+// Trace messages are compiled only into debug builds
+#ifdef NDEBUG
+constexpr bool TRACE_LOGGING = false;
+#else
+constexpr bool TRACE_LOGGING = true;
+#endif
+
+// Destination of log messages: the console and the log file. Messages are written by a background thread and the
+// streams are flushed by flush() and after each error message. A buffered sink keeps the messages until it is flushed,
+// so the logs of files converted at the same time do not interleave
+class LogSink {
+public:
+    explicit LogSink(std::ofstream& logFile, bool buffered = false, LogLevel level = LogLevel::Info)
+        : logFile_(logFile), buffered_(buffered), level_(level) {}
+    ~LogSink() { flush(); }
+
+    // Disable copy semantics
+    LogSink(const LogSink&) = delete;
+    LogSink& operator=(const LogSink&) = delete;
+
+    // Queue a message for the background writer, or keep it until the next flush in a buffered sink.
+    // An unbuffered sink waits until an error message ("ERROR ...") is written and flushed
+    void write(const std::string& message);
+
+    // Write the buffered messages as one block and wait until everything logged so far reaches the console and the file
+    void flush();
+
+    // Underlying log file
+    std::ofstream& file() { return logFile_; }
+
+    // Most detailed level logged by the sink
+    LogLevel level() const { return level_; }
+
+    // Whether messages of the level are logged
+    bool enabled(LogLevel level) const { return level <= level_; }
+
+private:
+    std::ofstream& logFile_;
+    bool buffered_;
+    LogLevel level_;
+    std::string buffer_;
+};
 
 // Log messages to both a log file and console
-void logMessage(const std::string& message, std::ofstream& logFile);
+void logMessage(const std::string& message, LogSink& logFile);
+
+// Log a message of the given level. It is formatted only if the sink logs the level, and trace messages are removed
+// from release builds entirely, so the arguments should be values already at hand rather than computed for the message
+template <LogLevel level, typename... Args>
+void logAt(LogSink& logFile, std::format_string<Args...> format, Args&&... args) {
+    if constexpr (level != LogLevel::Trace || TRACE_LOGGING) {
+        if (!logFile.enabled(level)) return;
+
+        std::string message = level == LogLevel::Error ? "ERROR - " : level == LogLevel::Warning ? "WARNING - " : "";
+        std::format_to(std::back_inserter(message), format, std::forward<Args>(args)...);
+        logFile.write(message);
+    }
+}
+
+template <typename... Args>
+void logError(LogSink& logFile, std::format_string<Args...> format, Args&&... args) {
+    logAt<LogLevel::Error>(logFile, format, std::forward<Args>(args)...);
+}
+
+template <typename... Args>
+void logWarning(LogSink& logFile, std::format_string<Args...> format, Args&&... args) {
+    logAt<LogLevel::Warning>(logFile, format, std::forward<Args>(args)...);
+}
+
+template <typename... Args>
+void logInfo(LogSink& logFile, std::format_string<Args...> format, Args&&... args) {
+    logAt<LogLevel::Info>(logFile, format, std::forward<Args>(args)...);
+}
+
+template <typename... Args>
+void logTrace(LogSink& logFile, std::format_string<Args...> format, Args&&... args) {
+    logAt<LogLevel::Trace>(logFile, format, std::forward<Args>(args)...);
+}
 
 // Clear log file
 void logClear();
 
 // Log errors, close the database and terminate the program
-[[noreturn]] void logErrorAndExit(const std::string& errorMessage, std::ofstream& logFile);
+[[noreturn]] void logErrorAndExit(const std::string& errorMessage, LogSink& logFile);
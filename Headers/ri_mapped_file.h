@@ -0,0 +1,34 @@
+#pragma once
+#include <filesystem>
+#include <stdexcept>
+#include <string_view>
+
+class MappedFile {
+public:
+    // Constructor that maps the whole file read-only
+    explicit MappedFile(const std::filesystem::path& path);
+    ~MappedFile();
+
+    // Disable copy semantics
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Enable move semantics
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+
+    // View of the mapped bytes, valid for the lifetime of the object
+    std::string_view view() const { return { data_, size_ }; }
+
+    // Size of the mapped file in bytes
+    size_t size() const { return size_; }
+
+private:
+    void unmap() noexcept;
+
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+#ifdef _WIN32
+    void* mapping_ = nullptr;
+#endif
+};
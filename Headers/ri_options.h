@@ -20,6 +20,9 @@ constexpr const char* TES3CONV_COMMAND = "tes3conv.exe";
 constexpr const char* TES3CONV_COMMAND = "./tes3conv";
 #endif
 
+// Define the refr_index database file name
+constexpr const char* DATABASE_FILE = "tes3_ri_en-ru_refr_index.db";
+
 // Define an alias for ordered_json type from the nlohmann library
 using ordered_json = nlohmann::ordered_json;
 
@@ -27,14 +30,22 @@ using ordered_json = nlohmann::ordered_json;
 struct ProgramOptions {
     bool batchMode = false;
     bool silentMode = false;
+    bool inPlace = false;
+    bool useTes3conv = false;
+    bool preloadDb = false;
+    bool streamJson = false;
+    bool spliceJson = false;
+    bool pipeline = false;
+    bool summaryMode = false;
+    unsigned jobs = 1;
+    unsigned maxProcesses = 0;
+    unsigned tes3convTimeout = 0;
+    unsigned memoryBudget = 0;
+    std::filesystem::path reportPath;
+    std::filesystem::path tracePath;
     std::vector<std::filesystem::path> inputFiles;
     int conversionType = 0;
 };
 
 // Function to parse command-line arguments
-ProgramOptions parseArguments(int argc, char* argv[]);
-
-// Global data structures for validation and mismatch tracking:
-extern std::unordered_set<int> validMastersIn;
-extern std::unordered_set<int> validMastersDb;
-extern std::unordered_set<MismatchEntry> mismatchedEntries;
\ No newline at end of file
+ProgramOptions parseArguments(int argc, char* argv[]);
\ No newline at end of file
@@ -0,0 +1,10 @@
+#pragma once
+#include <filesystem>
+
+#include "ri_logger.h"
+#include "ri_options.h"
+
+// Function to write the changed refr_index values and the conversion tag of natively read plugin data
+// into the .ESP|ESM bytes. Patches sourcePath in place when both paths are equal, otherwise writes a patched copy
+bool patchPluginFile(const std::filesystem::path& sourcePath, const std::filesystem::path& targetPath,
+    const ordered_json& pluginData, const std::string& convPrefix, const ProgramOptions& options, LogSink& logFile);
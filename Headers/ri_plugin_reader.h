@@ -0,0 +1,17 @@
+#pragma once
+#include <filesystem>
+#include <optional>
+
+#include "ri_logger.h"
+#include "ri_options.h"
+
+// Function to read the header, cells and references of a .ESP|ESM file directly from its binary records,
+// producing the same Header/Cell/references layout that tes3conv writes to .JSON. References also carry
+// "frmr_offset" (and "mvrf_offset" for moved references), the header carries "description_offset".
+// Records are parsed as views of the mapped file; only those members are copied into the result, which the
+// reference processing and the patcher share with the tes3conv path
+std::optional<ordered_json> readPluginFile(const std::filesystem::path& pluginPath, LogSink& logFile);
+
+// Function to read only the TES3 header record of a .ESP|ESM file (HEDR description and MAST list),
+// producing a Header-only array for the conversion tag and dependency checks
+std::optional<ordered_json> readPluginHeader(const std::filesystem::path& pluginPath, LogSink& logFile);
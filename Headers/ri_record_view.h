@@ -0,0 +1,99 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+// Sizes of the TES3 record and subrecord headers
+constexpr size_t RECORD_HEADER_SIZE = 16;
+constexpr size_t SUBRECORD_HEADER_SIZE = 8;
+
+// Read a little-endian 32-bit value
+inline uint32_t readU32(const char* data) {
+    uint32_t value;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+// Read a little-endian 64-bit value
+inline uint64_t readU64(const char* data) {
+    uint64_t value;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+// Zero-copy view of a subrecord: tag and data point into the mapped file
+struct SubrecordView {
+    std::string_view tag;
+    std::string_view data;
+    size_t offset = 0;  // File offset of the subrecord data
+
+    // Value of a 32-bit field at the given position of the data
+    uint32_t u32(size_t at = 0) const { return readU32(data.data() + at); }
+
+    // Text of a null-terminated string field
+    std::string_view text() const { return data.substr(0, data.find('\0')); }
+};
+
+// Zero-copy view of a record: tag and body point into the mapped file
+struct RecordView {
+    std::string_view tag;
+    std::string_view body;
+    size_t offset = 0;  // File offset of the record body
+    uint32_t flags = 0;
+};
+
+// Sequential reader of the chunks (records or subrecords) stored in a block of bytes
+template <typename View, size_t HeaderSize>
+class ChunkReader {
+public:
+    ChunkReader(std::string_view data, size_t offset) : data_(data), offset_(offset) {}
+
+    // Move to the next chunk, returns false at the end of the data or on a truncated chunk
+    bool next(View& view) {
+        if (position_ == data_.size()) return false;
+        if (data_.size() - position_ < HeaderSize) {
+            malformed_ = true;
+            return false;
+        }
+
+        const size_t size = readU32(data_.data() + position_ + 4);
+        if (size > data_.size() - position_ - HeaderSize) {
+            malformed_ = true;
+            return false;
+        }
+
+        view.tag = data_.substr(position_, 4);
+        view.offset = offset_ + position_ + HeaderSize;
+        if constexpr (requires { view.flags; }) {
+            view.flags = readU32(data_.data() + position_ + 12);
+            view.body = data_.substr(position_ + HeaderSize, size);
+        }
+        else {
+            view.data = data_.substr(position_ + HeaderSize, size);
+        }
+
+        position_ += HeaderSize + size;
+        return true;
+    }
+
+    // Whether reading stopped on a truncated chunk
+    bool malformed() const { return malformed_; }
+
+private:
+    std::string_view data_;
+    size_t offset_;
+    size_t position_ = 0;
+    bool malformed_ = false;
+};
+
+// Reader of the records of a plugin file
+class RecordReader : public ChunkReader<RecordView, RECORD_HEADER_SIZE> {
+public:
+    explicit RecordReader(std::string_view file) : ChunkReader(file, 0) {}
+};
+
+// Reader of the subrecords of a record
+class SubrecordReader : public ChunkReader<SubrecordView, SUBRECORD_HEADER_SIZE> {
+public:
+    explicit SubrecordReader(const RecordView& record) : ChunkReader(record.body, record.offset) {}
+};
@@ -0,0 +1,56 @@
+#pragma once
+#include <sqlite3.h>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// One row of the refr_index table
+struct RefrIndexRow {
+    int refrIndexEn;
+    int refrIndexRu;
+    std::string id;
+    int master;  // 2 - Tribunal, 3 - Bloodmoon
+};
+
+// Master index of a Master column value (0 - not an expansion)
+inline int parseMasterName(std::string_view master) {
+    if (master == "Tribunal") return 2;
+    if (master == "Bloodmoon") return 3;
+    return 0;
+}
+
+// In-memory copy of the refr_index table with open-addressing hash lookups for both conversion directions
+class RefrIndexMap {
+public:
+    // Constructor that loads the whole table from an open database connection
+    explicit RefrIndexMap(sqlite3* db);
+
+    // All rows with the refr_index in table order, empty if there are none
+    std::span<const RefrIndexRow> findRows(int conversionChoice, int refrIndex) const;
+
+    // Refr_index a row is looked up by for the conversion choice
+    static int sourceRefIndex(const RefrIndexRow& row, int conversionChoice) {
+        return conversionChoice == 1 ? row.refrIndexRu : row.refrIndexEn;
+    }
+
+    // Target refr_index of a row for the conversion choice
+    static int targetRefIndex(const RefrIndexRow& row, int conversionChoice) {
+        return conversionChoice == 1 ? row.refrIndexEn : row.refrIndexRu;
+    }
+
+    // Number of loaded rows
+    size_t size() const { return rows_[0].size(); }
+
+private:
+    // Open-addressing table of the first row of every refr_index (0 - empty slot, otherwise row index + 1)
+    struct Table {
+        std::vector<uint32_t> slots;
+        size_t mask = 0;
+    };
+
+    // Rows per conversion choice, grouped by the source refr_index and kept in table order within a group
+    std::vector<RefrIndexRow> rows_[2];
+    Table index_[2];
+};
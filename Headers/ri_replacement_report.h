@@ -0,0 +1,47 @@
+#pragma once
+#include <cstddef>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "ri_logger.h"
+#include "ri_options.h"
+
+// Kind of a reported reference
+enum class ReferenceEvent { Replaced, Mismatch, ReplacedMismatch };
+
+// References of a file collected in summary mode: the console gets the counts of each cell,
+// the per-reference detail goes to a .TSV file next to the plugin, written in one pass
+class ReplacementReport {
+public:
+    // Start the next cell, its label is taken from the first reference recorded in it
+    void beginCell() { cellStarted_ = true; }
+
+    // Record a reference of the current cell
+    void record(const ordered_json& cell, ReferenceEvent event, int refrIndexJson, const std::string& idJson,
+        int refrIndexDb, const std::string& idDb);
+
+    // Mark the mismatches recorded since the last call as replaced
+    void acceptMismatches();
+
+    // Log the counts of each cell and write the .TSV file. Returns false if the file could not be written
+    bool write(const std::filesystem::path& pluginPath, LogSink& logFile) const;
+
+private:
+    struct Row {
+        size_t cell;
+        ReferenceEvent event;
+        int refrIndexJson;
+        std::string idJson;
+        int refrIndexDb;
+        std::string idDb;
+    };
+
+    std::vector<std::string> cellLabels_;
+    std::vector<Row> rows_;
+    size_t unresolvedMismatches_ = 0;  // First row not yet covered by acceptMismatches
+    bool cellStarted_ = false;
+};
+
+// Function to get the path of the .TSV report of a plugin
+std::filesystem::path replacementReportPath(const std::filesystem::path& pluginPath);
@@ -0,0 +1,67 @@
+#pragma once
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <string>
+
+#include "ri_logger.h"
+#include "ri_options.h"
+
+struct ConversionSession;
+class StepTimer;
+
+// Steps of the conversion of a file timed for the run report
+enum class TimedStep { Prescan, Decode, Parse, Lookup, Mismatches, Serialize, Encode, Commit, Queued, Count };
+
+// Measurements of the conversion of a single file
+struct FileMetrics {
+    std::array<double, static_cast<size_t>(TimedStep::Count)> stepSeconds{};  // Time spent in each step
+    double totalSeconds = 0;                                                   // Time from the first to the last stage
+
+    uintmax_t inputBytes = 0;   // Plugin before conversion
+    uintmax_t jsonBytes = 0;    // tes3conv .JSON, 0 if the plugin was read natively
+    uintmax_t outputBytes = 0;  // Converted plugin
+    size_t references = 0;      // References looked up in the database
+    size_t queries = 0;         // SQLite queries, including the check for convertible references; 0 with --preload
+
+    bool converted = false;
+    const char* stoppedIn = nullptr;   // Stage that ended the conversion of a file that was not converted
+    StepTimer* activeTimer = nullptr;  // Innermost running timer
+};
+
+// Adds the time from construction to destruction to a step of the file. Timers nest: while an inner timer runs,
+// the outer one is paused, so every moment is counted for one step only
+class StepTimer {
+public:
+    StepTimer(FileMetrics& metrics, TimedStep step);
+    ~StepTimer();
+
+    // Disable copy semantics
+    StepTimer(const StepTimer&) = delete;
+    StepTimer& operator=(const StepTimer&) = delete;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    FileMetrics& metrics_;
+    const TimedStep step_;
+    StepTimer* const outer_;
+    Clock::time_point start_;
+};
+
+// Results of all files of a run, collected from every worker and written as .JSON for --report
+class RunReport {
+public:
+    // Add the results of a finished file
+    void addFile(const ConversionSession& session);
+
+    // Write the report sorted by file path. Returns false if the file could not be written
+    bool write(const std::filesystem::path& reportPath, const ProgramOptions& options, double totalSeconds, LogSink& logFile) const;
+
+private:
+    mutable std::mutex mutex_;
+    ordered_json files_ = ordered_json::array();
+};
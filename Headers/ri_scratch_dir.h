@@ -0,0 +1,22 @@
+#pragma once
+#include <filesystem>
+#include <stdexcept>
+
+// Private directory for the temporary .JSON files of one conversion, created in the system temp directory outside
+// the mod directory and removed with its contents
+class ScratchDirectory {
+public:
+    // Constructor that creates a new empty directory accessible only to the current user
+    ScratchDirectory();
+    ~ScratchDirectory();
+
+    // Disable copy semantics
+    ScratchDirectory(const ScratchDirectory&) = delete;
+    ScratchDirectory& operator=(const ScratchDirectory&) = delete;
+
+    // Path of the directory
+    const std::filesystem::path& path() const { return path_; }
+
+private:
+    std::filesystem::path path_;
+};
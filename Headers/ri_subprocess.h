@@ -0,0 +1,49 @@
+#pragma once
+#include <chrono>
+#include <filesystem>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "ri_trace.h"
+
+// Outcome of a finished child process
+struct ProcessResult {
+    int exitCode = -1;        // Exit code, -1 if the process was killed or ended abnormally
+    bool timedOut = false;    // Whether the process was killed after the timeout
+    std::string errorOutput;  // Captured stderr, truncated to the first 64 KiB
+};
+
+// Child process started directly (posix_spawn|CreateProcess, no shell) with its stderr captured through a pipe.
+// stdout is shared with the console, stdin is not inherited. At most setLimit() children run at the same time,
+// further constructors wait for a free slot
+class Subprocess {
+public:
+    // Constructor that starts the program with the given arguments
+    Subprocess(const std::filesystem::path& program, const std::vector<std::filesystem::path>& arguments);
+    ~Subprocess();
+
+    // Disable copy semantics
+    Subprocess(const Subprocess&) = delete;
+    Subprocess& operator=(const Subprocess&) = delete;
+
+    // Wait for the process to exit, a non-zero timeout kills it once exceeded. Can only be called once
+    ProcessResult wait(std::chrono::milliseconds timeout = std::chrono::milliseconds::zero());
+
+    // Set the maximum number of running children, 0 - unlimited
+    static void setLimit(unsigned limit);
+
+private:
+    void terminate() noexcept;
+
+#ifdef _WIN32
+    void* process_ = nullptr;
+    void* errorPipe_ = nullptr;
+#else
+    int pid_ = -1;
+    int errorPipe_ = -1;
+#endif
+    bool finished_ = false;
+    std::optional<TraceSpan> lifetime_;  // From the start of the child until it is reaped
+};
@@ -0,0 +1,32 @@
+#pragma once
+#include <chrono>
+#include <filesystem>
+#include <string>
+#include <string_view>
+
+#include "ri_logger.h"
+
+// Function to start recording trace events, spans created before are not recorded
+void enableTracing();
+
+// Function to write the recorded events in Chrome trace-event format, for chrome://tracing or Perfetto
+bool writeTrace(const std::filesystem::path& tracePath, LogSink& logFile);
+
+// Span of work on the current thread, recorded as one complete event when destroyed. Does nothing unless tracing
+// was enabled, the names are copied only then
+class TraceSpan {
+public:
+    TraceSpan(std::string_view category, std::string_view name, const std::filesystem::path& file = {});
+    ~TraceSpan();
+
+    // Disable copy semantics
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+private:
+    bool active_ = false;
+    std::string category_;
+    std::string name_;
+    std::string file_;
+    std::chrono::steady_clock::time_point start_;
+};
@@ -3,18 +3,18 @@
 #include <unordered_set>
 #include <vector>
 #include <filesystem>
-#include <fstream>
 
+#include "ri_logger.h"
 #include "ri_options.h"
 
 // Unified function for handling user choices
-int getUserChoice(const std::string& prompt, const std::unordered_set<std::string>& validChoices, std::ofstream& logFile);
+int getUserChoice(const std::string& prompt, const std::unordered_set<std::string>& validChoices, LogSink& logFile);
 
 // Function for handling user conversion choices
-int getUserConversionChoice(std::ofstream& logFile);
+int getUserConversionChoice(LogSink& logFile);
 
 // Function for handling user mismatch choices
-int getUserMismatchChoice(std::ofstream& logFile, const ProgramOptions& options);
+int getUserMismatchChoice(LogSink& logFile, const ProgramOptions& options);
 
 // Function for handling input file paths from user with recursive directory search
-std::vector<std::filesystem::path> getInputFilePaths(const ProgramOptions& options, std::ofstream& logFile);
\ No newline at end of file
+std::vector<std::filesystem::path> getInputFilePaths(const ProgramOptions& options, LogSink& logFile);
\ No newline at end of file
@@ -0,0 +1,49 @@
+#include <algorithm>
+#include <numeric>
+#include <utility>
+
+#include "ri_admission_queue.h"
+
+AdmissionQueue::AdmissionQueue(std::vector<uintmax_t> memoryEstimates, uintmax_t memoryBudget)
+    : memoryEstimates_(std::move(memoryEstimates)), waiting_(memoryEstimates_.size()), memoryBudget_(memoryBudget) {
+    std::iota(waiting_.begin(), waiting_.end(), size_t{ 0 });
+}
+
+std::optional<size_t> AdmissionQueue::take() {
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    while (!waiting_.empty()) {
+        auto fits = std::find_if(waiting_.begin(), waiting_.end(), [this](size_t item) {
+            return memoryBudget_ == 0 || running_ == 0 || memoryInUse_ + memoryEstimates_[item] <= memoryBudget_;
+            });
+
+        if (fits != waiting_.end()) {
+            const size_t item = *fits;
+            waiting_.erase(fits);
+            memoryInUse_ += memoryEstimates_[item];
+            ++running_;
+            return item;
+        }
+
+        released_.wait(lock);
+    }
+
+    return std::nullopt;
+}
+
+void AdmissionQueue::raise(size_t item, uintmax_t memoryEstimate) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (memoryEstimate <= memoryEstimates_[item]) return;
+
+    memoryInUse_ += memoryEstimate - memoryEstimates_[item];
+    memoryEstimates_[item] = memoryEstimate;
+}
+
+void AdmissionQueue::release(size_t item) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        memoryInUse_ -= memoryEstimates_[item];
+        --running_;
+    }
+    released_.notify_all();
+}
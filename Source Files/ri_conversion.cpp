@@ -0,0 +1,685 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <format>
+#include <memory>
+#include <numeric>
+#include <optional>
+#include <string>
+#include <thread>
+
+#include "ri_admission_queue.h"
+#include "ri_bounded_queue.h"
+#include "ri_conversion.h"
+#include "ri_data_processor.h"
+#include "ri_file_processor.h"
+#include "ri_json_splice.h"
+#include "ri_json_stream.h"
+#include "ri_logger.h"
+#include "ri_mapped_file.h"
+#include "ri_plugin_patcher.h"
+#include "ri_plugin_reader.h"
+#include "ri_run_report.h"
+#include "ri_scratch_dir.h"
+#include "ri_trace.h"
+
+namespace {
+    // Admitted item of an AdmissionQueue, returned to it on destruction
+    struct AdmissionTicket {
+        AdmissionTicket(AdmissionQueue& admission, size_t item) : admission(admission), item(item) {}
+        ~AdmissionTicket() { admission.release(item); }
+
+        // Disable copy semantics
+        AdmissionTicket(const AdmissionTicket&) = delete;
+        AdmissionTicket& operator=(const AdmissionTicket&) = delete;
+
+        // Charge the item a larger memory estimate
+        void raise(uintmax_t memoryEstimate) { admission.raise(item, memoryEstimate); }
+
+        AdmissionQueue& admission;
+        const size_t item;
+    };
+
+    // State of a single file handed from one conversion stage to the next
+    struct PluginJob {
+        explicit PluginJob(ConversionSession& session, AdmissionTicket* ticket = nullptr) : session(session), ticket(ticket) {}
+
+        ConversionSession& session;
+        AdmissionTicket* ticket;  // Memory budget of the file in a parallel batch, nullptr otherwise
+        std::chrono::high_resolution_clock::time_point start;
+
+        // Header, cells and references: read natively, parsed or scanned from .JSON
+        std::optional<ordered_json> pluginData;
+        bool nativePatch = false;  // The plugin is patched directly, without tes3conv
+        bool streamed = false;     // The .JSON was processed and saved in a single pass
+
+        // Temporary .JSON files of the tes3conv path
+        std::optional<ScratchDirectory> scratchDir;
+        std::filesystem::path jsonImportPath;
+        std::filesystem::path jsonExportPath;
+        std::optional<MappedFile> jsonText;
+    };
+
+    // A stage returns false once the file is done, either skipped or failed
+    using ConversionStage = bool (*)(PluginJob& job, const Database& db);
+
+    // Function to get the size of a file, 0 if it cannot be read
+    uintmax_t fileSize(const std::filesystem::path& path) {
+        std::error_code ec;
+        const uintmax_t size = std::filesystem::file_size(path, ec);
+        return ec ? 0 : size;
+    }
+
+    // Function to estimate the conversion cost of a file by its size, unreadable files cost nothing
+    uintmax_t conversionCost(const std::filesystem::path& pluginPath) {
+        return fileSize(pluginPath);
+    }
+
+    // Function to estimate the peak memory of converting a file through tes3conv from its size: the .JSON is several
+    // times larger than the plugin and its DOM several times larger than the text
+    uintmax_t estimateTes3convMemory(const std::filesystem::path& pluginPath, const ProgramOptions& options) {
+        uintmax_t tes3convFactor = 32;
+        if (options.spliceJson) tes3convFactor = 8;
+        else if (options.streamJson) tes3convFactor = 4;
+        return conversionCost(pluginPath) * tes3convFactor;
+    }
+
+    // Function to estimate the peak memory of converting a file from its size, for the path it is expected to take.
+    // The native read keeps the references only; a file whose native read fails is charged the tes3conv estimate
+    // when it falls back
+    uintmax_t estimatePeakMemory(const std::filesystem::path& pluginPath, const ProgramOptions& options) {
+        constexpr uintmax_t nativeFactor = 4;
+        const uintmax_t nativeMemory = conversionCost(pluginPath) * nativeFactor;
+        return options.useTes3conv ? std::max(nativeMemory, estimateTes3convMemory(pluginPath, options)) : nativeMemory;
+    }
+
+    // Function to define the conversion prefix
+    std::string conversionPrefix(const ProgramOptions& options) {
+        return (options.conversionType == 1) ? "RU->EN" : "EN->RU";
+    }
+
+    // Function to log the time spent on the file
+    void logFileTime(const PluginJob& job) {
+        auto fileEnd = std::chrono::high_resolution_clock::now();
+        auto fileDuration = fileEnd - job.start;
+        auto seconds = std::chrono::duration<double>(fileDuration).count();
+        if (!job.session.options.silentMode) {
+            logMessage(std::format("\nFile converted in: {:.3f} seconds\n", seconds), job.session.logFile);
+        }
+    }
+
+    // Function to delete the temporary .JSON files of a file without replacements
+    void skipWithoutReplacements(PluginJob& job) {
+        const ProgramOptions& options = job.session.options;
+        LogSink& logFile = job.session.logFile;
+
+        // A mapped file cannot be deleted on Windows; anything left over goes with the scratch directory
+        job.jsonText.reset();
+        std::error_code ec;
+        std::filesystem::remove(job.jsonImportPath, ec);
+        const bool exportRemoved = std::filesystem::remove(job.jsonExportPath, ec);
+        logMessage("No replacements found for file: " + job.session.pluginPath.string() + " - conversion skipped...", logFile);
+        if (options.silentMode) {
+            logMessage("", logFile);
+        }
+        else if (exportRemoved) {
+            logMessage("Temporary .JSON files deleted: " + job.jsonImportPath.string() + "\n" +
+                       "                          and: " + job.jsonExportPath.string() + "\n", logFile);
+        }
+        else {
+            logMessage("Temporary .JSON file deleted: " + job.jsonImportPath.string() + "\n", logFile);
+        }
+    }
+
+    // Stage 1: check the header, read the plugin natively or convert it to .JSON with tes3conv
+    bool decodeStage(PluginJob& job, const Database& db) {
+        ConversionSession& session = job.session;
+        const std::filesystem::path& pluginImportPath = session.pluginPath;
+        const ProgramOptions& options = session.options;
+        LogSink& logFile = session.logFile;
+
+        // Time file start
+        job.start = std::chrono::high_resolution_clock::now();
+        StepTimer prescanTimer(session.metrics, TimedStep::Prescan);
+        session.metrics.inputBytes = fileSize(pluginImportPath);
+
+        logMessage("Processing file: " + pluginImportPath.string(), logFile);
+
+        // Prescan the TES3 header record only, so ineligible files are rejected before anything else is read
+        auto pluginHeader = readPluginHeader(pluginImportPath, logFile);
+        if (!pluginHeader) {
+            logMessage("ERROR - failed to read header of file: " + pluginImportPath.string() + " - conversion skipped...\n", logFile);
+            return false;
+        }
+
+        // Check if file was already converted
+        if (hasConversionTag(*pluginHeader, pluginImportPath, logFile)) {
+            logMessage("ERROR - file " + pluginImportPath.string() + " was already converted - conversion skipped...\n", logFile);
+            return false;
+        }
+
+        // Check the dependency order
+        if (!checkDependencyOrder(*pluginHeader, session)) {
+            logMessage("ERROR - required Parent Masters not found for file: " + pluginImportPath.string() + " - conversion skipped...\n", logFile);
+            return false;
+        }
+
+        // Read the plugin natively, so files with nothing to convert never reach tes3conv
+        auto pluginData = readPluginFile(pluginImportPath, logFile);
+        if (pluginData) {
+            // Patch the FRMR values of the plugin directly, unless re-encoding through tes3conv was requested
+            if (!options.useTes3conv) {
+                job.pluginData = std::move(pluginData);
+                job.nativePatch = true;
+                return true;
+            }
+
+            if (!hasConvertibleReferences(db, *pluginData, session)) {
+                logMessage("No replacements found for file: " + pluginImportPath.string() + " - conversion skipped...\n", logFile);
+                return false;
+            }
+        }
+        else {
+            if (!options.silentMode) {
+                logMessage("Native read failed, falling back to tes3conv: " + pluginImportPath.string(), logFile);
+            }
+
+            // The file was admitted for the native path, the files started after it are held back by its tes3conv cost
+            if (job.ticket && !options.useTes3conv) job.ticket->raise(estimateTes3convMemory(pluginImportPath, options));
+        }
+
+        // Temporary .JSON files are kept out of the mod directory and removed with the scratch directory
+        job.scratchDir.emplace();
+
+        // Define the input and the modified .JSON file paths
+        job.jsonImportPath = job.scratchDir->path() / (pluginImportPath.stem().string() + ".json");
+        job.jsonExportPath = job.scratchDir->path() / std::format("TEMP_{}{}", pluginImportPath.stem().string(), ".json");
+
+        // Convert the input file to .JSON
+        bool decoded = false;
+        {
+            StepTimer decodeTimer(session.metrics, TimedStep::Decode);
+            decoded = runTes3conv(pluginImportPath, job.jsonImportPath, options, logFile);
+        }
+        if (!decoded) {
+            logMessage("ERROR - converting to .JSON failed for file: " + pluginImportPath.string() + "\n", logFile);
+            return false;
+        }
+        session.metrics.jsonBytes = fileSize(job.jsonImportPath);
+        if (!options.silentMode) {
+            logMessage("Conversion to .JSON successful: " + job.jsonImportPath.string(), logFile);
+        }
+
+        return true;
+    }
+
+    // Stage 2: load the tes3conv .JSON, in streaming mode it is also processed and saved here
+    bool parseStage(PluginJob& job, const Database& db) {
+        if (job.nativePatch) return true;
+
+        ConversionSession& session = job.session;
+        StepTimer parseTimer(session.metrics, TimedStep::Parse);
+        const std::filesystem::path& pluginImportPath = session.pluginPath;
+        const ProgramOptions& options = session.options;
+        LogSink& logFile = session.logFile;
+
+        // Scan only the references, the original text is kept for splicing the changed numbers in
+        if (options.spliceJson) {
+            try {
+                job.jsonText.emplace(job.jsonImportPath);
+            }
+            catch (const std::exception& e) {
+                logMessage("ERROR - failed to read .JSON file: " + std::string(e.what()) + "\n", logFile);
+                return false;
+            }
+
+            job.pluginData = scanJsonReferences(job.jsonText->view(), logFile);
+            if (!job.pluginData) {
+                logMessage("ERROR - processing failed for file: " + pluginImportPath.string() + "\n", logFile);
+                return false;
+            }
+            return true;
+        }
+
+        // Process and save the .JSON one top-level element at a time, the header is tagged as soon as it is read
+        if (options.streamJson) {
+            const std::string convPrefix = conversionPrefix(options);
+            auto processElement = [&](ordered_json& element) {
+                if (element.is_object() && element.value("type", "") == "Header") {
+                    ordered_json header = ordered_json::array({ std::move(element) });
+                    const bool tagged = addConversionTag(header, convPrefix, options, logFile);
+                    element = std::move(header[0]);
+                    if (!tagged) logMessage("ERROR - could not find or modify header description", logFile);
+                    return tagged;
+                }
+
+                processStreamedCell(db, session, element);
+                return true;
+                };
+
+            if (!streamJsonArray(job.jsonImportPath, job.jsonExportPath, processElement, logFile)) {
+                std::error_code ec;
+                std::filesystem::remove(job.jsonExportPath, ec);
+                logMessage("ERROR - processing failed for file: " + pluginImportPath.string() + "\n", logFile);
+                return false;
+            }
+
+            if (session.mismatchChoice == 0 && !options.silentMode) {
+                logMessage("No mismatched entries found - skipping mismatch handling...", logFile);
+            }
+
+            // Check if any replacements were made, the report then only lists the kept mismatches
+            if (session.replacements == 0) {
+                if (options.summaryMode) session.report.write(pluginImportPath, logFile);
+                skipWithoutReplacements(job);
+                return false;
+            }
+
+            if (!options.silentMode) {
+                logMessage("Modified data saved as: " + job.jsonExportPath.string(), logFile);
+            }
+
+            job.streamed = true;
+            return true;
+        }
+
+        // Load the generated JSON file straight from its mapping
+        job.pluginData = loadJsonFile(job.jsonImportPath, options, logFile);
+        return job.pluginData.has_value();
+    }
+
+    // Stage 3: look up the new refr_index values and tag the header
+    bool patchStage(PluginJob& job, const Database& db) {
+        if (job.streamed) return true;
+
+        ConversionSession& session = job.session;
+        StepTimer patchTimer(session.metrics, TimedStep::Lookup);
+        const std::filesystem::path& pluginImportPath = session.pluginPath;
+        const ProgramOptions& options = session.options;
+        LogSink& logFile = session.logFile;
+
+        // Process replacements and mismatches
+        if (processReplacementsAndMismatches(db, session, *job.pluginData) == -1) {
+            logMessage("ERROR - processing failed for file: " + pluginImportPath.string() + "\n", logFile);
+            return false;
+        }
+
+        // Check if any replacements were made, the report then only lists the kept mismatches
+        if (session.replacements == 0) {
+            if (options.summaryMode) session.report.write(pluginImportPath, logFile);
+            if (job.nativePatch) {
+                logMessage("No replacements found for file: " + pluginImportPath.string() + " - conversion skipped...\n", logFile);
+            }
+            else {
+                skipWithoutReplacements(job);
+            }
+            return false;
+        }
+
+        // Add conversion tag to header
+        if (!addConversionTag(*job.pluginData, conversionPrefix(options), options, logFile) && !job.nativePatch) {
+            logMessage("ERROR - could not find or modify header description\n", logFile);
+            return false;
+        }
+
+        return true;
+    }
+
+    // Stage 4: save the modified .JSON for tes3conv
+    bool serializeStage(PluginJob& job, const Database&) {
+        if (job.nativePatch || job.streamed) return true;
+
+        const ProgramOptions& options = job.session.options;
+        LogSink& logFile = job.session.logFile;
+        StepTimer serializeTimer(job.session.metrics, TimedStep::Serialize);
+
+        // Write the original text with the changed numbers spliced in
+        if (options.spliceJson) {
+            if (!spliceJsonFile(job.jsonText->view(), *job.pluginData, job.jsonExportPath, logFile)) {
+                logMessage("ERROR - failed to save modified data to .JSON file: " + job.jsonExportPath.string() + "\n", logFile);
+                return false;
+            }
+
+            if (!options.silentMode) {
+                logMessage("Modified data saved as: " + job.jsonExportPath.string(), logFile);
+            }
+        }
+
+        // Save the modified data to .JSON file
+        else if (!saveJsonToFile(job.jsonExportPath, *job.pluginData, options, logFile)) {
+            logMessage("ERROR - failed to save modified data to .JSON file: " + job.jsonExportPath.string() + "\n", logFile);
+            return false;
+        }
+
+        // The data is not needed by the remaining stages
+        job.pluginData.reset();
+        job.jsonText.reset();
+        return true;
+    }
+
+    // Stage 5: back up the original file and convert the modified .JSON to .ESP|ESM with tes3conv
+    bool encodeStage(PluginJob& job, const Database&) {
+        if (job.nativePatch) return true;
+
+        const std::filesystem::path& pluginImportPath = job.session.pluginPath;
+        const ProgramOptions& options = job.session.options;
+        LogSink& logFile = job.session.logFile;
+        StepTimer encodeTimer(job.session.metrics, TimedStep::Encode);
+
+        // Create backup before modifying original file
+        bool backedUp = false;
+        {
+            StepTimer backupTimer(job.session.metrics, TimedStep::Commit);
+            backedUp = createBackup(pluginImportPath, options, logFile).has_value();
+        }
+        if (!backedUp) {
+            std::error_code ec;
+            std::filesystem::remove(job.jsonImportPath, ec);
+            if (!options.silentMode) {
+                logMessage("Temporary .JSON file deleted: " + job.jsonImportPath.string(), logFile);
+            }
+
+            return false;
+        }
+
+        // Save converted file with original name
+        if (!convertJsonToEsp(job.jsonExportPath, pluginImportPath, options, logFile)) {
+            logMessage("ERROR - failed to convert .JSON back to .ESP|ESM: " + pluginImportPath.string() + "\n", logFile);
+            return false;
+        }
+
+        return true;
+    }
+
+    // Stage 6: write the natively patched file, or clean up after tes3conv
+    bool commitStage(PluginJob& job, const Database&) {
+        const std::filesystem::path& pluginImportPath = job.session.pluginPath;
+        const ProgramOptions& options = job.session.options;
+        LogSink& logFile = job.session.logFile;
+        StepTimer commitTimer(job.session.metrics, TimedStep::Commit);
+
+        if (job.nativePatch) {
+            // Patch a copy made from the backup, or the original file itself in in-place mode
+            std::filesystem::path sourcePath = pluginImportPath;
+            if (!options.inPlace) {
+                auto backupPath = createBackup(pluginImportPath, options, logFile);
+                if (!backupPath) return false;
+                sourcePath = *backupPath;
+            }
+
+            if (!patchPluginFile(sourcePath, pluginImportPath, *job.pluginData, conversionPrefix(options), options, logFile)) {
+                // Restore the original file from its backup
+                if (sourcePath != pluginImportPath) {
+                    std::filesystem::remove(pluginImportPath);
+                    std::filesystem::rename(sourcePath, pluginImportPath);
+                }
+                logMessage("ERROR - failed to patch .ESP|ESM: " + pluginImportPath.string() + "\n", logFile);
+                return false;
+            }
+        }
+        else {
+            // Clean up temporary .JSON files, anything left over goes with the scratch directory
+            std::error_code ec;
+            std::filesystem::remove(job.jsonImportPath, ec);
+            std::filesystem::remove(job.jsonExportPath, ec);
+            if (!options.silentMode) {
+                logMessage("Temporary .JSON files deleted: " + job.jsonImportPath.string() + "\n" +
+                           "                          and: " + job.jsonExportPath.string(), logFile);
+            }
+        }
+
+        // Log the counts of each cell and save the per-reference detail, only once the file is actually converted
+        if (options.summaryMode) job.session.report.write(pluginImportPath, logFile);
+
+        job.session.metrics.converted = true;
+        job.session.metrics.outputBytes = fileSize(pluginImportPath);
+
+        // Time file total
+        logFileTime(job);
+        return false;
+    }
+
+    constexpr std::array<ConversionStage, 6> conversionStages = {
+        decodeStage, parseStage, patchStage, serializeStage, encodeStage, commitStage
+    };
+
+    // Names of the stages in the run report and the trace
+    constexpr std::array<const char*, conversionStages.size()> stageNames = {
+        "decode", "parse", "patch", "serialize", "encode", "commit"
+    };
+
+    // Function to run one stage of a file, exceptions end the conversion of the file
+    bool runStage(size_t stage, PluginJob& job, const Database& db) {
+        TraceSpan stageSpan("stage", stageNames[stage], job.session.pluginPath);
+        try {
+            return conversionStages[stage](job, db);
+        }
+        catch (const std::exception& e) {
+            logMessage("ERROR - failed to process file " + job.session.pluginPath.string() + ": " + e.what() + "\n", job.session.logFile);
+            return false;
+        }
+    }
+
+    // Function to add a file that left the stages to the run report, stage - the one that ended it
+    void finishPluginFile(PluginJob& job, size_t stage, RunReport& runReport) {
+        FileMetrics& metrics = job.session.metrics;
+        // Files drained from the first queue were never started
+        if (job.start != std::chrono::high_resolution_clock::time_point{}) {
+            metrics.totalSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - job.start).count();
+        }
+        if (!metrics.converted) metrics.stoppedIn = stageNames[stage];
+        runReport.addFile(job.session);
+    }
+
+    // Function to run the stages of a file one after another
+    void runPluginJob(PluginJob& job, const Database& db, RunReport& runReport) {
+        size_t stage = 0;
+        while (runStage(stage, job, db) && stage + 1 < conversionStages.size()) ++stage;
+        finishPluginFile(job, stage, runReport);
+
+        // The log reaches the console and the file at the end of each file
+        job.session.logFile.flush();
+    }
+
+    // File moving through the pipeline together with its own log
+    struct PipelineItem {
+        PipelineItem(const std::filesystem::path& pluginPath, const ProgramOptions& options, LogSink& logFile,
+            AdmissionQueue& admission, size_t item)
+            : ticket(admission, item), fileLog(logFile.file(), true, logFile.level()), session(pluginPath, options, fileLog), job(session, &ticket) {}
+
+        // Destroyed last, so the memory of the file is released before the next one is admitted
+        AdmissionTicket ticket;
+
+        // The log of a file is written as one block once the file leaves the pipeline
+        LogSink fileLog;
+        ConversionSession session;
+        PluginJob job;
+
+        // When the file was handed to the queue of its next stage
+        std::chrono::high_resolution_clock::time_point queuedSince;
+    };
+
+    // Function to add the time a file waited for its next stage to the queued step
+    void addQueuedTime(PipelineItem& item) {
+        if (item.queuedSince == std::chrono::high_resolution_clock::time_point{}) return;
+
+        const auto waited = std::chrono::high_resolution_clock::now() - item.queuedSince;
+        item.session.metrics.stepSeconds[static_cast<size_t>(TimedStep::Queued)] += std::chrono::duration<double>(waited).count();
+        item.queuedSince = {};
+    }
+
+    // Function to log the memory budget of a parallel batch
+    void logMemoryBudget(const ProgramOptions& options, LogSink& logFile) {
+        if (options.memoryBudget != 0 && !options.silentMode) {
+            logMessage("Memory budget: " + std::to_string(options.memoryBudget) + " MB, files are started while their estimate fits...", logFile);
+        }
+    }
+
+    // Function to convert the files in a pipeline: each stage has its own workers and passes the files on through
+    // a bounded queue, so one file can be in tes3conv while the next one is parsed and looked up
+    void convertPluginFilesPipelined(const std::vector<std::filesystem::path>& inputPaths, const Database& db,
+        const ProgramOptions& options, LogSink& logFile, RunReport& runReport) {
+
+        // Queue i feeds stage i; with one slot per worker at most a few files per stage are held in memory
+        const size_t workersPerStage = std::max<size_t>(options.jobs, 1);
+        using ItemQueue = BoundedQueue<std::unique_ptr<PipelineItem>>;
+        std::vector<std::unique_ptr<ItemQueue>> queues;
+        for (size_t i = 0; i < conversionStages.size(); ++i) {
+            queues.push_back(std::make_unique<ItemQueue>(workersPerStage));
+        }
+
+        if (!options.silentMode) {
+            logMessage("Converting " + std::to_string(inputPaths.size()) + " files in a pipeline of " +
+                       std::to_string(conversionStages.size()) + " stages with " + std::to_string(workersPerStage) +
+                       " worker(s) each...\n", logFile);
+        }
+
+        // The last worker of a stage to finish closes the queue of the next stage
+        std::array<std::atomic<size_t>, conversionStages.size()> runningWorkers;
+        for (auto& running : runningWorkers) running = workersPerStage;
+
+        auto worker = [&](size_t stage) {
+            try {
+                Database workerDb(DATABASE_FILE);
+                workerDb.shareRefrIndexMap(db);
+
+                while (auto item = queues[stage]->pop()) {
+                    addQueuedTime(**item);
+                    const bool continues = runStage(stage, (*item)->job, workerDb);
+                    if (continues && stage + 1 < conversionStages.size()) {
+                        (*item)->queuedSince = std::chrono::high_resolution_clock::now();
+                        queues[stage + 1]->push(std::move(*item));
+                    }
+                    else {
+                        finishPluginFile((*item)->job, stage, runReport);
+                    }
+                }
+            }
+            catch (const std::exception& e) {
+                logMessage("ERROR - worker stopped: " + std::string(e.what()) + "\n", logFile);
+                // Drain the queue, so the earlier stages are not blocked; the drained files are still logged and reported
+                while (auto item = queues[stage]->pop()) {
+                    addQueuedTime(**item);
+                    PluginJob& job = (*item)->job;
+                    logMessage("ERROR - worker stopped before file: " + job.session.pluginPath.string() + " - conversion skipped...\n",
+                        job.session.logFile);
+                    finishPluginFile(job, stage, runReport);
+                }
+            }
+
+            if (--runningWorkers[stage] == 0 && stage + 1 < conversionStages.size()) {
+                queues[stage + 1]->close();
+            }
+            };
+
+        // With several workers per stage the largest files go first, so none of them is left for the end
+        std::vector<std::filesystem::path> orderedPaths = inputPaths;
+        if (workersPerStage > 1) {
+            std::vector<uintmax_t> costs;
+            costs.reserve(orderedPaths.size());
+            for (const auto& pluginImportPath : orderedPaths) costs.push_back(conversionCost(pluginImportPath));
+
+            std::vector<size_t> order(orderedPaths.size());
+            std::iota(order.begin(), order.end(), size_t{ 0 });
+            std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return costs[a] > costs[b]; });
+            for (size_t i = 0; i < order.size(); ++i) orderedPaths[i] = inputPaths[order[i]];
+        }
+
+        // Files enter the pipeline while the memory of the files inside it fits the budget
+        std::vector<uintmax_t> memoryEstimates;
+        memoryEstimates.reserve(orderedPaths.size());
+        for (const auto& pluginImportPath : orderedPaths) memoryEstimates.push_back(estimatePeakMemory(pluginImportPath, options));
+        AdmissionQueue admission(std::move(memoryEstimates), static_cast<uintmax_t>(options.memoryBudget) * 1024 * 1024);
+        logMemoryBudget(options, logFile);
+
+        // The workers are joined before the admission queue their items release into is destroyed
+        std::vector<std::jthread> workers;
+        workers.reserve(conversionStages.size() * workersPerStage);
+        for (size_t stage = 0; stage < conversionStages.size(); ++stage) {
+            for (size_t i = 0; i < workersPerStage; ++i) {
+                workers.emplace_back(worker, stage);
+            }
+        }
+
+        while (const auto item = admission.take()) {
+            queues.front()->push(std::make_unique<PipelineItem>(orderedPaths[*item], options, logFile, admission, *item));
+        }
+        queues.front()->close();
+    }
+}
+
+// Function to convert the refr_index values of a single .ESP|ESM file
+void convertPluginFile(ConversionSession& session, const Database& db, RunReport& runReport) {
+    PluginJob job(session);
+    runPluginJob(job, db, runReport);
+}
+
+// Function to convert all input files, spread over a pool of workers when several jobs are requested
+void convertPluginFiles(const std::vector<std::filesystem::path>& inputPaths, const Database& db,
+    const ProgramOptions& options, LogSink& logFile, RunReport& runReport) {
+
+    // Overlap the stages of consecutive files
+    if (options.pipeline && options.batchMode && inputPaths.size() > 1) {
+        convertPluginFilesPipelined(inputPaths, db, options, logFile, runReport);
+        return;
+    }
+
+    const size_t jobs = options.batchMode ? std::min<size_t>(options.jobs, inputPaths.size()) : 1;
+
+    // Sequential processing of each file
+    if (jobs <= 1) {
+        for (const auto& pluginImportPath : inputPaths) {
+            ConversionSession session(pluginImportPath, options, logFile);
+            convertPluginFile(session, db, runReport);
+        }
+        return;
+    }
+
+    // Largest files first: the workers take the next file as soon as they are free, so the small files
+    // fill the gaps at the end instead of a large master starting last and deciding the total time
+    std::vector<std::pair<uintmax_t, const std::filesystem::path*>> files;
+    files.reserve(inputPaths.size());
+    for (const auto& pluginImportPath : inputPaths) {
+        files.emplace_back(conversionCost(pluginImportPath), &pluginImportPath);
+    }
+    std::stable_sort(files.begin(), files.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+
+    if (!options.silentMode) {
+        logMessage("Converting " + std::to_string(inputPaths.size()) + " files with " + std::to_string(jobs) + " jobs...\n", logFile);
+    }
+
+    // A file is started while the memory of the running files fits the budget
+    std::vector<uintmax_t> memoryEstimates;
+    memoryEstimates.reserve(files.size());
+    for (const auto& [cost, pluginImportPath] : files) memoryEstimates.push_back(estimatePeakMemory(*pluginImportPath, options));
+    AdmissionQueue admission(std::move(memoryEstimates), static_cast<uintmax_t>(options.memoryBudget) * 1024 * 1024);
+    logMemoryBudget(options, logFile);
+
+    // Each worker takes the next admitted file and uses its own database connection
+    auto worker = [&]() {
+        try {
+            Database workerDb(DATABASE_FILE);
+            workerDb.shareRefrIndexMap(db);
+
+            while (const auto file = admission.take()) {
+                AdmissionTicket ticket(admission, *file);
+
+                // The log of a file is written as one block once the file is done
+                LogSink fileLog(logFile.file(), true, logFile.level());
+                ConversionSession session(*files[*file].second, options, fileLog);
+                PluginJob job(session, &ticket);
+                runPluginJob(job, workerDb, runReport);
+            }
+        }
+        catch (const std::exception& e) {
+            logMessage("ERROR - worker stopped: " + std::string(e.what()) + "\n", logFile);
+        }
+        };
+
+    std::vector<std::jthread> workers;
+    workers.reserve(jobs);
+    for (size_t i = 0; i < jobs; ++i) {
+        workers.emplace_back(worker);
+    }
+}
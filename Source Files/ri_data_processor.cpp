@@ -1,212 +1,367 @@
+#include <atomic>
+#include <optional>
+#include <thread>
+#include <utility>
+#include <vector>
+
 #include "json.hpp"
 
 #include "ri_data_processor.h"
 #include "ri_logger.h"
 #include "ri_options.h"
+#include "ri_trace.h"
 #include "ri_user_interaction.h"
 
-// Function to fetch the refr_index from the database
-std::optional<int> fetchRefIndex(const Database& db, const std::string& query, int refrIndexJson, const std::string& idJson) {
-    sqlite3_stmt* stmt = nullptr;
-    if (sqlite3_prepare_v2(db, query.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
-        return std::nullopt;
+// Function to determine which master the database lookup is limited to (0 - none, 2 - Tribunal, 3 - Bloodmoon)
+int getMasterFilter(int mastIndex, const std::unordered_set<int>& validMastersDb) {
+    if (validMastersDb.count(1)) {
+        if (mastIndex == 2 || mastIndex == 3) return mastIndex;
+        return 0;
     }
+    if (validMastersDb.count(2)) return 2;
+    if (validMastersDb.count(3)) return 3;
+    return 0;
+}
 
-    auto stmt_ptr = std::unique_ptr<sqlite3_stmt, decltype(&sqlite3_finalize)>(stmt, sqlite3_finalize);
-    sqlite3_bind_int(stmt_ptr.get(), 1, refrIndexJson);
-    sqlite3_bind_text(stmt_ptr.get(), 2, idJson.c_str(), static_cast<int>(idJson.length()), SQLITE_TRANSIENT);
+bool RefrIndexLookup::addRow(int target, std::string_view id, int master, std::string_view idJson, int masterFilter) {
+    if (!refrIndex && id == idJson) {
+        refrIndex = target;
+    }
 
-    if (sqlite3_step(stmt_ptr.get()) == SQLITE_ROW) {
-        return sqlite3_column_int(stmt_ptr.get(), 0);
+    if (refrIndexDb == -1 && (masterFilter == 0 || master == masterFilter)) {
+        refrIndexDb = target;
+        idDb = id;
     }
-    return std::nullopt;
+
+    return refrIndex && refrIndexDb != -1;
 }
 
-// Template function to fetch ID from the database based on the fetch mode
-template <FetchMode mode>
-auto fetchID(const Database& db, int refrIndexJson, int mastIndex, const std::unordered_set<int>& validMastersDb, int conversionChoice) {
-    std::string query;
-
-    // Determine the query based on the conversion choice and fetch mode
-    switch (conversionChoice) {
-    case 1:
-        query = (mode == FETCH_DB_ID)
-            ? "SELECT ID FROM [tes3_T-B_en-ru_refr_index] WHERE refr_index_RU = ?"
-            : "SELECT refr_index_EN FROM [tes3_T-B_en-ru_refr_index] WHERE refr_index_RU = ?";
-        break;
-    case 2:
-        query = (mode == FETCH_DB_ID)
-            ? "SELECT ID FROM [tes3_T-B_en-ru_refr_index] WHERE refr_index_EN = ?"
-            : "SELECT refr_index_RU FROM [tes3_T-B_en-ru_refr_index] WHERE refr_index_EN = ?";
-        break;
-    default:
-        if constexpr (mode == FETCH_DB_ID) return std::string();
-        else return -1;
-    }
-
-    // Append conditions to the query based on the valid masters
-    if (validMastersDb.count(1)) {
-        if (mastIndex == 2) query += " AND Master = 'Tribunal'";
-        else if (mastIndex == 3) query += " AND Master = 'Bloodmoon'";
+// Function to look up the replacement and the mismatch candidate of a reference with a single query
+RefrIndexLookup lookupRefrIndex(const Database& db, int conversionChoice, int refrIndexJson, const std::string& idJson, int masterFilter) {
+    RefrIndexLookup lookup;
+
+    if (const RefrIndexMap* refrIndexMap = db.refrIndexMap()) {
+        for (const auto& row : refrIndexMap->findRows(conversionChoice, refrIndexJson)) {
+            if (lookup.addRow(RefrIndexMap::targetRefIndex(row, conversionChoice), row.id, row.master, idJson, masterFilter)) break;
+        }
+        return lookup;
     }
-    else if (validMastersDb.count(2)) query += " AND Master = 'Tribunal'";
-    else if (validMastersDb.count(3)) query += " AND Master = 'Bloodmoon'";
 
-    sqlite3_stmt* stmt = nullptr;
-    if (sqlite3_prepare_v2(db, query.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
-        if constexpr (mode == FETCH_DB_ID) return std::string();
-        else return -1;
+    // One statement per conversion choice returns every row with the refr_index, the id and master are matched here
+    const StatementKey key{ conversionChoice };
+    sqlite3_stmt* stmt = db.cachedStatement(key);
+    if (!stmt) {
+        switch (conversionChoice) {
+        case 1:
+            stmt = db.prepareStatement(key, "SELECT refr_index_EN, ID, Master FROM [tes3_T-B_en-ru_refr_index] WHERE refr_index_RU = ? ORDER BY rowid;");
+            break;
+        case 2:
+            stmt = db.prepareStatement(key, "SELECT refr_index_RU, ID, Master FROM [tes3_T-B_en-ru_refr_index] WHERE refr_index_EN = ? ORDER BY rowid;");
+            break;
+        default:
+            break;
+        }
+        if (!stmt) return lookup;
     }
 
-    auto stmt_ptr = std::unique_ptr<sqlite3_stmt, decltype(&sqlite3_finalize)>(stmt, sqlite3_finalize);
-    sqlite3_bind_int(stmt_ptr.get(), 1, refrIndexJson);
+    // Reset as soon as the lookup is done, not when the statement is next used
+    StatementReset reset(stmt);
+    sqlite3_bind_int(stmt, 1, refrIndexJson);
+    lookup.queried = true;
 
-    // Fetch the value based on the fetch mode
-    if constexpr (mode == FETCH_DB_ID) {
-        std::string idDb;
-        if (sqlite3_step(stmt_ptr.get()) == SQLITE_ROW) {
-            const char* idJson = reinterpret_cast<const char*>(sqlite3_column_text(stmt_ptr.get(), 0));
-            if (idJson) idDb = idJson;
-        }
-        return idDb;
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        const char* idDb = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
+        const char* master = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2));
+        if (lookup.addRow(sqlite3_column_int(stmt, 0), idDb ? idDb : "", master ? parseMasterName(master) : 0, idJson, masterFilter)) break;
     }
-    else {
-        int refrIndexDb = -1;
-        if (sqlite3_step(stmt_ptr.get()) == SQLITE_ROW) {
-            refrIndexDb = sqlite3_column_int(stmt_ptr.get(), 0);
+
+    return lookup;
+}
+
+// Function to check whether any reference has a replacement or mismatch in the database
+bool hasConvertibleReferences(const Database& db, const ordered_json& inputData, ConversionSession& session) {
+    const int conversionChoice = session.options.conversionType;
+
+    for (const auto& cell : inputData) {
+        if (!cell.contains("references") || !cell["references"].is_array()) continue;
+
+        for (const auto& referenceData : cell["references"]) {
+            if (!referenceData.contains("refr_index") || !referenceData["refr_index"].is_number_integer() ||
+                !referenceData.contains("id") || !referenceData["id"].is_string()) {
+                continue;
+            }
+
+            const int inputRefIndex = referenceData["refr_index"];
+            const int inputMastIndex = referenceData.value("mast_index", -1);
+            if (!session.validMastersIn.count(inputMastIndex)) continue;
+
+            // Stop at the first reference that would be replaced or reported as a mismatch
+            const RefrIndexLookup lookup = lookupRefrIndex(db, conversionChoice, inputRefIndex,
+                referenceData["id"].get<std::string>(), getMasterFilter(inputMastIndex, session.validMastersDb));
+            if (lookup.queried) ++session.metrics.queries;
+            if (lookup.refrIndex || lookup.refrIndexDb != -1) {
+                return true;
+            }
         }
-        return refrIndexDb;
     }
+
+    return false;
+}
+
+// Function to get the references array of a cell, nullptr for other records
+const ordered_json* getCellReferences(const ordered_json& cell) {
+    // Skip non-cell entries or cells without proper type
+    if (!cell.contains("type") || cell["type"] != "Cell") return nullptr;
+
+    // Extract references array from cell
+    auto referencesIter = cell.find("references");
+    if (referencesIter == cell.end() || !referencesIter->is_array()) return nullptr;
+
+    return &*referencesIter;
+}
+
+// Function to check whether a reference is looked up: it has a numeric refr_index, a string id and a valid master
+bool isLookupCandidate(const ordered_json& referenceData, const ConversionSession& session) {
+    // Validate reference structure
+    if (!referenceData.contains("refr_index") || !referenceData["refr_index"].is_number_integer() ||
+        !referenceData.contains("id") || !referenceData["id"].is_string()) {
+        return false;
+    }
+
+    // Valid Parent Master files check
+    return session.validMastersIn.count(referenceData.value("mast_index", -1)) != 0;
 }
 
-// Function to process replacements and mismatches
-int processReplacementsAndMismatches(const Database& db, const ProgramOptions& options, const std::string& query, ordered_json& inputData,
-    int conversionChoice, int& replacementsFlag,
-    const std::unordered_set<int>& validMastersDb,
-    std::unordered_set<MismatchEntry>& mismatchedEntries,
-    std::ofstream& logFile) {
+// Function to look up the references of a single cell without changing anything, in reference order
+void lookupCellReferences(const Database& db, const ConversionSession& session, const ordered_json& cell,
+    std::vector<RefrIndexLookup>& lookups) {
+    const ordered_json* cellReferences = getCellReferences(cell);
+    if (!cellReferences) return;
 
-    // Validate root JSON structure
-    if (!inputData.is_array()) {
-        logMessage("ERROR - input JSON is not an array, unable to process!", logFile);
-        return -1;
+    for (const auto& referenceData : *cellReferences) {
+        if (!isLookupCandidate(referenceData, session)) continue;
+
+        const int inputMastIndex = referenceData.value("mast_index", -1);
+        lookups.push_back(lookupRefrIndex(db, session.options.conversionType, referenceData["refr_index"],
+            referenceData["id"].get<std::string>(), getMasterFilter(inputMastIndex, session.validMastersDb)));
     }
+}
 
-    // Process each cell in the JSON array
-    for (auto cellIter = inputData.begin(); cellIter != inputData.end(); ++cellIter) {
+// Function to look up the references of a single cell, recording its mismatched references
+void processCellReferences(const Database& db, ConversionSession& session, ordered_json& cell,
+    MismatchedReferences& mismatchedReferences, std::vector<RefrIndexLookup>* lookups) {
+    const ProgramOptions& options = session.options;
+    const int conversionChoice = options.conversionType;
+    LogSink& logFile = session.logFile;
 
-        // Skip non-cell entries or cells without proper type
-        if (!cellIter->contains("type") || (*cellIter)["type"] != "Cell") continue;
+    // Skip non-cell entries and cells without references
+    if (!getCellReferences(cell)) return;
+    auto& cellReferences = cell["references"];
+    if (options.summaryMode) session.report.beginCell();
 
-        // Extract references array from cell
-        auto& cellReferences = (*cellIter)["references"];
-        if (!cellReferences.is_array()) continue;
+    // Process individual references in cell
+    size_t nextLookup = 0;
+    for (auto refIter = cellReferences.begin(); refIter != cellReferences.end(); ++refIter) {
+        auto& referenceData = *refIter;
 
-        // Process individual references in cell
-        for (auto refIter = cellReferences.begin(); refIter != cellReferences.end(); ++refIter) {
-            auto& referenceData = *refIter;
+        if (!isLookupCandidate(referenceData, session)) continue;
 
-            // Validate reference structure
-            if (!referenceData.contains("refr_index") || !referenceData["refr_index"].is_number_integer() ||
-                !referenceData.contains("id") || !referenceData["id"].is_string()) {
-                continue;
+        // Extract reference data
+        int inputRefIndex = referenceData["refr_index"];
+        std::string inputId = referenceData["id"];
+        int inputMastIndex = referenceData.value("mast_index", -1);
+
+        // Look up both the replacement and the mismatch candidate at once, unless it was done in advance
+        const RefrIndexLookup lookup = lookups ? std::move((*lookups)[nextLookup++]) :
+            lookupRefrIndex(db, conversionChoice, inputRefIndex, inputId, getMasterFilter(inputMastIndex, session.validMastersDb));
+        ++session.metrics.references;
+        if (lookup.queried) ++session.metrics.queries;
+
+        // Handle replacements
+        if (const auto& foundRefIndex = lookup.refrIndex) {
+            referenceData["refr_index"] = *foundRefIndex;
+            if (options.summaryMode) {
+                session.report.record(cell, ReferenceEvent::Replaced, inputRefIndex, inputId, *foundRefIndex, inputId);
             }
+            else {
+                logInfo(logFile, "Replaced JSON refr_index {} with DB refr_index {} for JSON id {}",
+                    inputRefIndex, *foundRefIndex, inputId);
+            }
+            ++session.replacements;
+        }
 
-            // Extract reference data
-            int inputRefIndex = referenceData["refr_index"];
-            std::string inputId = referenceData["id"];
-            int inputMastIndex = referenceData.value("mast_index", -1);
+        // Handle mismatches
+        else {
+            const int refrIndexDb = lookup.refrIndexDb;
 
-            // Valid Parent Master files check
-            if (!validMastersIn.count(inputMastIndex)) {
-                //if (!options.silentMode) {
-                    //logMessage("Skipping object (invalid master index): " + inputId, logFile);
-                //}
+            // Skip if no matching record found in DB
+            if (refrIndexDb == -1) {
+                logTrace(logFile, "Skipping object (no match in DB): JSON refr_index {} and JSON id {}", inputRefIndex, inputId);
                 continue;
             }
 
-            // Handle replacements
-            if (auto foundRefIndex = fetchRefIndex(db, query, inputRefIndex, inputId)) {
-                referenceData["refr_index"] = *foundRefIndex;
-                if (!options.silentMode) {
-                    logMessage("Replaced JSON refr_index " + std::to_string(inputRefIndex) +
-                               " with DB refr_index " + std::to_string(*foundRefIndex) +
-                               " for JSON id " + inputId, logFile);
-                }
-                replacementsFlag = 1;
-            }
+            const std::string& idDb = lookup.idDb;
 
-            // Handle mismatches
+            // Only proceed with mismatch handling if we have valid DB data
+            ++session.mismatches;
+            if (options.summaryMode) {
+                session.report.record(cell, ReferenceEvent::Mismatch, inputRefIndex, inputId, refrIndexDb, idDb);
+            }
             else {
-                const int refrIndexDb = fetchID<FETCH_OPPOSITE_REFR_INDEX>(db, inputRefIndex, inputMastIndex, validMastersDb, conversionChoice);
-
-                // Skip if no matching record found in DB
-                if (refrIndexDb == -1) {
-                    //if (!options.silentMode) {
-                        //logMessage("Skipping object (no match in DB): JSON refr_index " + std::to_string(inputRefIndex) +
-                        //           " and JSON id " + inputId, logFile);
-                    //}
-                    continue;
-                }
-
-                const std::string idDb = fetchID<FETCH_DB_ID>(db, inputRefIndex, inputMastIndex, validMastersDb, conversionChoice);
-
-                // Only proceed with mismatch handling if we have valid DB data
-                if (!options.silentMode) {
-                    logMessage("Mismatch found for JSON refr_index " + std::to_string(inputRefIndex) +
-                               " and JSON id " + inputId + " with DB refr_index " + std::to_string(refrIndexDb) +
-                               " and DB id " + idDb, logFile);
-                }
-
-                // Handle duplicated mismatches
-                if (auto [it, inserted] = mismatchedEntries.insert(
-                    MismatchEntry{ inputRefIndex, inputId, idDb, refrIndexDb }); !inserted) {
-                    if (!options.silentMode) {
-                        logMessage("WARNING - skipping duplicate mismatch entry for JSON refr_index " + std::to_string(inputRefIndex) +
-                                   " and JSON id " + inputId, logFile);
-                    }
-                }
+                logInfo(logFile, "Mismatch found for JSON refr_index {} and JSON id {} with DB refr_index {} and DB id {}",
+                    inputRefIndex, inputId, refrIndexDb, idDb);
             }
+
+            // Handle duplicated mismatches
+            auto [it, inserted] = session.mismatchedEntries.insert(MismatchEntry{ inputRefIndex, inputId, idDb, refrIndexDb });
+            mismatchedReferences.emplace_back(&referenceData, &*it);
+            if (!inserted && !options.summaryMode && !options.silentMode) {
+                logWarning(logFile, "skipping duplicate mismatch entry for JSON refr_index {} and JSON id {}", inputRefIndex, inputId);
+            }
+        }
+    }
+}
+
+// Function to replace the refr_index of the recorded mismatched references
+void applyMismatchReplacements(ConversionSession& session, const MismatchedReferences& mismatchedReferences) {
+    if (session.options.summaryMode) session.report.acceptMismatches();
+
+    for (const auto& [reference, entry] : mismatchedReferences) {
+        (*reference)["refr_index"] = entry->refrIndexDb;
+        if (!session.options.summaryMode) {
+            logInfo(session.logFile, "Replaced mismatched JSON refr_index {} with DB refr_index {} for JSON id {}",
+                entry->refrIndexJson, entry->refrIndexDb, entry->idJson);
         }
+        ++session.replacements;
     }
+}
+
+// Function to look up the references of all cells on several threads, each taking a contiguous range of cells with
+// about the same number of references. Returns the lookups of each cell, or nothing if the file is looked up serially
+std::vector<std::vector<RefrIndexLookup>> lookupCellsInParallel(const Database& db, const ConversionSession& session,
+    const ordered_json& inputData) {
+    std::vector<std::vector<RefrIndexLookup>> cellLookups;
+
+    // Files converted at the same time already keep the cores busy
+    const ProgramOptions& options = session.options;
+    const size_t threadCount = (options.jobs > 1 || options.pipeline) ? 1 : std::thread::hardware_concurrency();
+    if (threadCount < 2 || inputData.size() < MIN_PARALLEL_CELLS) return cellLookups;
+
+    std::vector<size_t> referenceCounts(inputData.size());
+    size_t totalReferences = 0;
+    for (size_t cell = 0; cell < inputData.size(); ++cell) {
+        const ordered_json* cellReferences = getCellReferences(inputData[cell]);
+        referenceCounts[cell] = cellReferences ? cellReferences->size() : 0;
+        totalReferences += referenceCounts[cell];
+    }
+    if (totalReferences < MIN_PARALLEL_REFERENCES) return cellLookups;
+
+    cellLookups.resize(inputData.size());
+    std::atomic<bool> failed = false;
 
-    // Handle user choice for mismatched entries
-    if (!mismatchedEntries.empty()) {
-        int mismatchChoice = getUserMismatchChoice(logFile, options);
-
-        if (mismatchChoice == 1) {
-            // Apply replacements for all tracked mismatches
-            for (const auto& entry : mismatchedEntries) {
-                for (auto& cell : inputData) {
-                    if (!cell.contains("references") || !cell["references"].is_array()) continue;
-
-                    // Find and update matching references
-                    for (auto& reference : cell["references"]) {
-                        if (reference["refr_index"] == entry.refrIndexJson &&
-                            reference.value("id", "") == entry.idJson) {
-                            reference["refr_index"] = entry.refrIndexDb;
-                            if (!options.silentMode) {
-                                logMessage("Replaced mismatched JSON refr_index " + std::to_string(entry.refrIndexJson) +
-                                           " with DB refr_index " + std::to_string(entry.refrIndexDb) +
-                                           " for JSON id " + entry.idJson, logFile);
-                            }
-                            replacementsFlag = 1;
-                        }
-                    }
-                }
+    auto worker = [&](size_t firstCell, size_t lastCell) {
+        TraceSpan lookupSpan("lookup", "lookup cells", session.pluginPath);
+        try {
+            // SQL lookups need a connection per thread, the preloaded map is shared
+            std::optional<Database> workerDb;
+            if (!db.refrIndexMap()) workerDb.emplace(DATABASE_FILE);
+            const Database& lookupDb = workerDb ? *workerDb : db;
+
+            for (size_t cell = firstCell; cell < lastCell; ++cell) {
+                lookupCellReferences(lookupDb, session, inputData[cell], cellLookups[cell]);
             }
         }
-        else {
-            if (!options.silentMode) {
-                logMessage("Mismatched entries will remain unchanged...", logFile);
+        catch (const std::exception&) {
+            failed = true;
+        }
+        };
+
+    {
+        std::vector<std::jthread> workers;
+        const size_t referencesPerThread = (totalReferences + threadCount - 1) / threadCount;
+        size_t firstCell = 0;
+        size_t rangeReferences = 0;
+        for (size_t cell = 0; cell < inputData.size(); ++cell) {
+            rangeReferences += referenceCounts[cell];
+            if (rangeReferences >= referencesPerThread || cell + 1 == inputData.size()) {
+                workers.emplace_back(worker, firstCell, cell + 1);
+                firstCell = cell + 1;
+                rangeReferences = 0;
             }
         }
     }
-    else {
-        if (!options.silentMode) {
-            logMessage("No mismatched entries found - skipping mismatch handling...", logFile);
+
+    // Fall back to serial lookups if a worker could not open the database
+    if (failed) cellLookups.clear();
+    return cellLookups;
+}
+
+// Function to process replacements and mismatches
+int processReplacementsAndMismatches(const Database& db, ConversionSession& session, ordered_json& inputData) {
+    const ProgramOptions& options = session.options;
+    LogSink& logFile = session.logFile;
+
+    // Validate root JSON structure
+    if (!inputData.is_array()) {
+        logError(logFile, "input JSON is not an array, unable to process!");
+        return -1;
+    }
+
+    // Mismatched references in file order with their entries, so accepted mismatches are applied in one pass
+    MismatchedReferences mismatchedReferences;
+
+    {
+        StepTimer lookupTimer(session.metrics, TimedStep::Lookup);
+
+        // Large files are looked up on several threads first, the results are then applied in file order
+        std::vector<std::vector<RefrIndexLookup>> cellLookups = lookupCellsInParallel(db, session, inputData);
+
+        // Process each cell in the JSON array
+        for (size_t cell = 0; cell < inputData.size(); ++cell) {
+            processCellReferences(db, session, inputData[cell], mismatchedReferences,
+                cellLookups.empty() ? nullptr : &cellLookups[cell]);
+        }
+    }
+
+    // Handle user choice for mismatched entries, the time includes the wait for the answer
+    StepTimer mismatchTimer(session.metrics, TimedStep::Mismatches);
+    if (!session.mismatchedEntries.empty()) {
+        session.mismatchChoice = getUserMismatchChoice(logFile, options);
+
+        if (session.mismatchChoice == 1) {
+            // Apply replacements for all tracked mismatches, including duplicates
+            applyMismatchReplacements(session, mismatchedReferences);
+        }
+        else {
+            logInfo(logFile, "Mismatched entries will remain unchanged...");
         }
     }
+    else {
+        logInfo(logFile, "No mismatched entries found - skipping mismatch handling...");
+    }
 
     return 0;
-}
\ No newline at end of file
+}
+
+// Function to process replacements and mismatches of one streamed cell, asking for the mismatch choice at the first mismatch
+void processStreamedCell(const Database& db, ConversionSession& session, ordered_json& cell) {
+    MismatchedReferences mismatchedReferences;
+    {
+        StepTimer lookupTimer(session.metrics, TimedStep::Lookup);
+        processCellReferences(db, session, cell, mismatchedReferences);
+    }
+    if (mismatchedReferences.empty()) return;
+
+    StepTimer mismatchTimer(session.metrics, TimedStep::Mismatches);
+
+    if (session.mismatchChoice == 0) {
+        session.mismatchChoice = getUserMismatchChoice(session.logFile, session.options);
+        if (session.mismatchChoice != 1) {
+            logInfo(session.logFile, "Mismatched entries will remain unchanged...");
+        }
+    }
+
+    if (session.mismatchChoice == 1) {
+        applyMismatchReplacements(session, mismatchedReferences);
+    }
+}
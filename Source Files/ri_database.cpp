@@ -11,4 +11,29 @@ Database::Database(const std::string& filename) {
     }
 
     db_.reset(db_raw);
-}
\ No newline at end of file
+}
+
+Database& Database::operator=(Database&& other) noexcept {
+    // Finalize the cached statements before the old connection is closed
+    statements_.clear();
+    db_ = std::move(other.db_);
+    statements_ = std::move(other.statements_);
+    refrIndexMap_ = std::move(other.refrIndexMap_);
+    return *this;
+}
+
+sqlite3_stmt* Database::cachedStatement(const StatementKey& key) const {
+    const auto it = statements_.find(key);
+    return it == statements_.end() ? nullptr : it->second.get();
+}
+
+sqlite3_stmt* Database::prepareStatement(const StatementKey& key, const std::string& query) const {
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v3(db_.get(), query.c_str(), -1, SQLITE_PREPARE_PERSISTENT, &stmt, nullptr) != SQLITE_OK) {
+        sqlite3_finalize(stmt);
+        return nullptr;
+    }
+
+    statements_[key].reset(stmt);
+    return stmt;
+}
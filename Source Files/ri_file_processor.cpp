@@ -1,13 +1,16 @@
 #include <algorithm>
+#include <chrono>
 #include <format>
-#include <cstdlib>
 
 #include "ri_file_processor.h"
+#include "ri_json_writer.h"
 #include "ri_logger.h"
+#include "ri_mapped_file.h"
+#include "ri_subprocess.h"
 #include "ri_options.h"
 
 // Function to check if file was already converted
-bool hasConversionTag(const ordered_json& inputData, const std::filesystem::path& filePath, std::ofstream& logFile) {
+bool hasConversionTag(const ordered_json& inputData, const std::filesystem::path& filePath, LogSink& logFile) {
     // Find the header section in the JSON data
     auto headerIter = std::find_if(inputData.begin(), inputData.end(), [](const ordered_json& item) {
         return item.contains("type") && item["type"] == "Header";
@@ -27,14 +30,16 @@ bool hasConversionTag(const ordered_json& inputData, const std::filesystem::path
 }
 
 // Function to check the dependency order of Parent Master files in the input .ESP|ESM data
-std::pair<bool, std::unordered_set<int>> checkDependencyOrder(const ordered_json& inputData, std::ofstream& logFile) {
+bool checkDependencyOrder(const ordered_json& inputData, ConversionSession& session) {
+    LogSink& logFile = session.logFile;
+
     auto headerIter = std::find_if(inputData.begin(), inputData.end(), [](const ordered_json& item) {
         return item.contains("type") && item["type"] == "Header";
         });
 
     if (headerIter == inputData.end() || !headerIter->contains("masters")) {
         logMessage("ERROR - missing 'header' section or 'masters' key!\n", logFile);
-        return { false, {} };
+        return false;
     }
 
     const auto& masters = (*headerIter)["masters"];
@@ -51,42 +56,47 @@ std::pair<bool, std::unordered_set<int>> checkDependencyOrder(const ordered_json
 
     if (!mwPos.has_value()) {
         logMessage("ERROR - Morrowind.esm dependency not found!", logFile);
-        return { false, {} };
+        return false;
     }
 
-    validMastersIn.clear();
-    validMastersDb.clear();
+    session.validMastersIn.clear();
+    session.validMastersDb.clear();
 
     if (tPos.has_value() && bPos.has_value()) {
         if (*tPos > *mwPos && *bPos > *tPos) {
             logMessage("Valid order of Parent Master files found: M+T+B", logFile);
-            validMastersIn = { 2, 3 };
-            validMastersDb = { 1 };
-            return { true, validMastersDb };
+            session.validMastersIn = { 2, 3 };
+            session.validMastersDb = { 1 };
+            return true;
         }
         logMessage("ERROR - invalid order of Parent Master files found: M+B+T", logFile);
-        return { false, {} };
+        return false;
     }
 
     if (tPos.has_value() && *tPos > *mwPos) {
         logMessage("Valid order of Parent Master files found: M+T", logFile);
-        validMastersIn = { 2 };
-        validMastersDb = { 2 };
-        return { true, validMastersDb };
+        session.validMastersIn = { 2 };
+        session.validMastersDb = { 2 };
+        return true;
     }
 
     if (bPos.has_value() && *bPos > *mwPos) {
         logMessage("Valid order of Parent Master files found: M+B", logFile);
-        validMastersIn = { 2 };
-        validMastersDb = { 3 };
-        return { true, validMastersDb };
+        session.validMastersIn = { 2 };
+        session.validMastersDb = { 3 };
+        return true;
     }
 
-    return { false, {} };
+    return false;
+}
+
+// Function to build the conversion tag appended to the header description
+std::string makeConversionTag(const std::string& convPrefix) {
+    return "\r\n\r\nConverted (" + convPrefix + ") by TES3 Ref_Ind Converter";
 }
 
 // Function to add conversion tags to the header description
-bool addConversionTag(ordered_json& inputData, const std::string& convPrefix, const ProgramOptions& options, std::ofstream& logFile) {
+bool addConversionTag(ordered_json& inputData, const std::string& convPrefix, const ProgramOptions& options, LogSink& logFile) {
     // Find the Header block in JSON
     auto headerIter = std::find_if(inputData.begin(), inputData.end(), [](const auto& item) {
         return item.contains("type") && item["type"] == "Header";
@@ -97,7 +107,7 @@ bool addConversionTag(ordered_json& inputData, const std::string& convPrefix, co
         std::string currentDesc = (*headerIter)["description"];
 
         // Add conversion tag
-        std::string conversionTag = "\r\n\r\nConverted (" + convPrefix + ") by TES3 Ref_Ind Converter";
+        std::string conversionTag = makeConversionTag(convPrefix);
         if (currentDesc.find(conversionTag) == std::string::npos) {
             (*headerIter)["description"] = currentDesc + conversionTag;
             if (!options.silentMode) {
@@ -110,8 +120,8 @@ bool addConversionTag(ordered_json& inputData, const std::string& convPrefix, co
     return false;
 }
 
-// Function to create backup with automatic numbering
-bool createBackup(const std::filesystem::path& filePath, const ProgramOptions& options, std::ofstream& logFile) {
+// Function to create backup with automatic numbering, returns the backup path
+std::optional<std::filesystem::path> createBackup(const std::filesystem::path& filePath, const ProgramOptions& options, LogSink& logFile) {
     std::filesystem::path backupPath;
     int counter = 0;
     const int maxBackups = 1000;
@@ -131,7 +141,7 @@ bool createBackup(const std::filesystem::path& filePath, const ProgramOptions& o
         if (counter >= maxBackups) {
             logMessage("ERROR - reached maximum backup count (" + std::to_string(maxBackups) +
                        ") for file: " + filePath.string(), logFile);
-            return false;
+            return std::nullopt;
         }
 
         // Perform the actual backup by renaming the file
@@ -139,34 +149,88 @@ bool createBackup(const std::filesystem::path& filePath, const ProgramOptions& o
         if (!options.silentMode) {
             logMessage("Original file backed up as: " + backupPath.string(), logFile);
         }
-        return true;
+        return backupPath;
     }
     catch (const std::exception& e) {
         // Log any errors that occur during backup process
         logMessage("ERROR - failed to create backup: " + filePath.string() + ": " + e.what() + "\n", logFile);
-        return false;
+        return std::nullopt;
+    }
+}
+
+// Function to load a .JSON file: the whole file is mapped and parsed from one contiguous buffer
+std::optional<ordered_json> loadJsonFile(const std::filesystem::path& jsonPath, const ProgramOptions& options, LogSink& logFile) {
+    try {
+        MappedFile inputFile(jsonPath);
+        const std::string_view inputText = inputFile.view();
+
+        auto parseStart = std::chrono::steady_clock::now();
+        ordered_json inputData = ordered_json::parse(inputText.begin(), inputText.end());
+        auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - parseStart).count();
+
+        if (inputData.is_discarded()) {
+            logMessage("ERROR - parsed JSON is invalid or empty: " + jsonPath.string() + "\n", logFile);
+            return std::nullopt;
+        }
+
+        if (!options.silentMode) {
+            const double megabytes = static_cast<double>(inputText.size()) / (1024.0 * 1024.0);
+            logMessage(std::format("JSON parsed in: {:.3f} seconds ({:.2f} MB, {:.1f} MB/s)",
+                                   seconds, megabytes, seconds > 0.0 ? megabytes / seconds : 0.0), logFile);
+        }
+        return inputData;
+    }
+    catch (const std::exception& e) {
+        logMessage("ERROR - failed to parse JSON (" + jsonPath.string() + "): " + e.what() + "\n", logFile);
+        return std::nullopt;
     }
 }
 
 // Function to save the modified JSON data to file
-bool saveJsonToFile(const std::filesystem::path& jsonImportPath, const ordered_json& inputData, const ProgramOptions& options, std::ofstream& logFile) {
-    std::ofstream outputFile(jsonImportPath);
-    if (!outputFile) return false;
-    outputFile << std::setw(2) << inputData;
+bool saveJsonToFile(const std::filesystem::path& jsonImportPath, const ordered_json& inputData, const ProgramOptions& options, LogSink& logFile) {
+    const auto bytesWritten = writeCompactJson(jsonImportPath, inputData, logFile);
+    if (!bytesWritten) return false;
     if (!options.silentMode) {
-        logMessage("Modified data saved as: " + jsonImportPath.string(), logFile);
+        logMessage("Modified data saved as: " + jsonImportPath.string() + " (" + std::to_string(*bytesWritten) + " bytes)", logFile);
     }
     return true;
 }
 
-// Function to convert the .JSON file to .ESP|ESM
-bool convertJsonToEsp(const std::filesystem::path& jsonImportPath, const std::filesystem::path& espFilePath, const ProgramOptions& options, std::ofstream& logFile) {
-    std::ostringstream command;
-    command << TES3CONV_COMMAND << " "
-        << std::quoted(jsonImportPath.string()) << " "
-        << std::quoted(espFilePath.string());
+// Function to run tes3conv on the input file to produce the output file, its error output is logged
+bool runTes3conv(const std::filesystem::path& inputPath, const std::filesystem::path& outputPath, const ProgramOptions& options, LogSink& logFile) {
+    ProcessResult result;
+    try {
+        Subprocess tes3conv(TES3CONV_COMMAND, { inputPath, outputPath });
+        result = tes3conv.wait(std::chrono::seconds(options.tes3convTimeout));
+    }
+    catch (const std::exception& e) {
+        logMessage("ERROR - " + std::string(e.what()), logFile);
+        return false;
+    }
 
-    if (std::system(command.str().c_str()) != 0) {
+    // Drop the trailing line break of the captured output
+    while (!result.errorOutput.empty() && (result.errorOutput.back() == '\n' || result.errorOutput.back() == '\r')) {
+        result.errorOutput.pop_back();
+    }
+
+    const bool succeeded = !result.timedOut && result.exitCode == 0;
+    if (result.timedOut) {
+        logMessage("ERROR - tes3conv was stopped after " + std::to_string(options.tes3convTimeout) + " seconds: " + inputPath.string(), logFile);
+    }
+    else if (!succeeded) {
+        logMessage("ERROR - tes3conv exited with code " + std::to_string(result.exitCode) + ": " + inputPath.string(), logFile);
+    }
+
+    if (!result.errorOutput.empty() && (!succeeded || !options.silentMode)) {
+        logMessage((succeeded ? "WARNING - tes3conv: " : "tes3conv: ") + result.errorOutput, logFile);
+    }
+
+    return succeeded;
+}
+
+// Function to convert the .JSON file to .ESP|ESM
+bool convertJsonToEsp(const std::filesystem::path& jsonImportPath, const std::filesystem::path& espFilePath, const ProgramOptions& options, LogSink& logFile) {
+    if (!runTes3conv(jsonImportPath, espFilePath, options, logFile)) {
         return false;
     }
 
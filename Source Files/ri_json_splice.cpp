@@ -0,0 +1,352 @@
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <fstream>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+#include "ri_json_splice.h"
+
+namespace {
+    // Minimal tokenizer over .JSON text: it walks the structure and reports the tokens the caller asks for,
+    // everything else is skipped without being decoded. The text is expected to be valid tes3conv output
+    class JsonScanner {
+    public:
+        explicit JsonScanner(std::string_view text) : text_(text) {}
+
+        // Current position in the text
+        size_t position() const { return position_; }
+
+        // Whether the next token starts with the character
+        bool peek(char c) {
+            skipWhitespace();
+            return position_ < text_.size() && text_[position_] == c;
+        }
+
+        // Consume the next token if it is the character
+        bool consume(char c) {
+            if (!peek(c)) return false;
+            ++position_;
+            return true;
+        }
+
+        // Raw string token, including the quotes
+        std::optional<std::string_view> stringToken() {
+            if (!peek('"')) return std::nullopt;
+
+            const size_t start = position_++;
+            while (position_ < text_.size()) {
+                const char c = text_[position_++];
+                if (c == '\\') ++position_;
+                else if (c == '"') return text_.substr(start, position_ - start);
+            }
+            return std::nullopt;
+        }
+
+        // Raw number token
+        std::optional<std::string_view> numberToken() {
+            skipWhitespace();
+            const size_t start = position_;
+            while (position_ < text_.size() && std::strchr("+-.0123456789eE", text_[position_]) && text_[position_] != '\0') {
+                ++position_;
+            }
+            if (position_ == start) return std::nullopt;
+            return text_.substr(start, position_ - start);
+        }
+
+        // Skip any value, including nested objects and arrays
+        bool skipValue() {
+            skipWhitespace();
+            if (position_ >= text_.size()) return false;
+
+            const char first = text_[position_];
+            if (first == '"') return stringToken().has_value();
+
+            if (first == '{' || first == '[') {
+                size_t depth = 0;
+                while (position_ < text_.size()) {
+                    const char c = text_[position_];
+                    if (c == '"') {
+                        if (!stringToken()) return false;
+                        continue;
+                    }
+                    if (c == '{' || c == '[') ++depth;
+                    else if ((c == '}' || c == ']') && --depth == 0) {
+                        ++position_;
+                        return true;
+                    }
+                    ++position_;
+                }
+                return false;
+            }
+
+            // Numbers and literals
+            const size_t start = position_;
+            while (position_ < text_.size() && !std::strchr(",]} \t\r\n", text_[position_])) ++position_;
+            return position_ > start;
+        }
+
+        // Walk the members of an object, onMember must consume the value of each key
+        template <typename OnMember>
+        bool scanObject(OnMember onMember) {
+            if (!consume('{')) return false;
+            if (consume('}')) return true;
+
+            do {
+                auto keyToken = stringToken();
+                if (!keyToken || !consume(':')) return false;
+                if (!onMember(keyToken->substr(1, keyToken->size() - 2))) return false;
+            } while (consume(','));
+
+            return consume('}');
+        }
+
+        // Walk the elements of an array, onElement must consume each element
+        template <typename OnElement>
+        bool scanArray(OnElement onElement) {
+            if (!consume('[')) return false;
+            if (consume(']')) return true;
+
+            do {
+                if (!onElement()) return false;
+            } while (consume(','));
+
+            return consume(']');
+        }
+
+    private:
+        void skipWhitespace() {
+            while (position_ < text_.size() && std::strchr(" \t\r\n", text_[position_]) && text_[position_] != '\0') {
+                ++position_;
+            }
+        }
+
+        std::string_view text_;
+        size_t position_ = 0;
+    };
+
+    // Value of a string token, escapes are decoded by the JSON parser only when present
+    std::optional<ordered_json> decodeString(std::optional<std::string_view> token) {
+        if (!token) return std::nullopt;
+        if (token->find('\\') == std::string_view::npos) return ordered_json(std::string(token->substr(1, token->size() - 2)));
+        return ordered_json::parse(*token, nullptr, false);
+    }
+
+    // Value of a number token, integers are converted without the JSON parser
+    std::optional<ordered_json> decodeNumber(std::optional<std::string_view> token) {
+        if (!token) return std::nullopt;
+        int64_t value = 0;
+        const auto [end, error] = std::from_chars(token->data(), token->data() + token->size(), value);
+        if (error == std::errc() && end == token->data() + token->size()) return ordered_json(value);
+        return ordered_json::parse(*token, nullptr, false);
+    }
+
+    // Replacement of a span of the original text
+    struct TextSplice {
+        size_t offset;
+        size_t length;
+        std::string text;
+    };
+
+#ifdef _WIN32
+    // Write the pieces one after another
+    bool writePieces(const std::filesystem::path& outputPath, const std::vector<std::string_view>& pieces) {
+        std::ofstream outputFile(outputPath, std::ios::binary | std::ios::trunc);
+        for (const auto& piece : pieces) {
+            outputFile.write(piece.data(), static_cast<std::streamsize>(piece.size()));
+        }
+        return static_cast<bool>(outputFile.flush());
+    }
+#else
+    // Write the pieces with gather writes, IOV_MAX pieces per call
+    bool writePieces(const std::filesystem::path& outputPath, const std::vector<std::string_view>& pieces) {
+        // Calls interrupted by a signal are retried
+        int fd = -1;
+        do {
+            fd = open(outputPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        } while (fd == -1 && errno == EINTR);
+        if (fd == -1) return false;
+
+        std::vector<iovec> vectors;
+        vectors.reserve(pieces.size());
+        for (const auto& piece : pieces) {
+            if (!piece.empty()) vectors.push_back({ const_cast<char*>(piece.data()), piece.size() });
+        }
+
+        size_t next = 0;
+        while (next < vectors.size()) {
+            const int count = static_cast<int>(std::min<size_t>(vectors.size() - next, IOV_MAX));
+            ssize_t written = writev(fd, vectors.data() + next, count);
+            if (written == -1 && errno == EINTR) continue;
+            if (written < 0) {
+                close(fd);
+                return false;
+            }
+
+            // Skip the fully written pieces and trim a partially written one
+            while (next < vectors.size() && static_cast<size_t>(written) >= vectors[next].iov_len) {
+                written -= static_cast<ssize_t>(vectors[next].iov_len);
+                ++next;
+            }
+            if (written > 0) {
+                vectors[next].iov_base = static_cast<char*>(vectors[next].iov_base) + written;
+                vectors[next].iov_len -= static_cast<size_t>(written);
+            }
+        }
+
+        return close(fd) == 0;
+    }
+#endif
+}
+
+// Function to scan tes3conv .JSON text for the header and the cell references without building the full DOM
+std::optional<ordered_json> scanJsonReferences(std::string_view jsonText, LogSink& logFile) {
+    JsonScanner scanner(jsonText);
+    ordered_json pluginData = ordered_json::array();
+
+    // Reference members needed for the lookups, the refr_index token is remembered for splicing
+    auto scanReference = [&](ordered_json& reference) {
+        return scanner.scanObject([&](std::string_view key) {
+            if (key == "refr_index") {
+                auto token = scanner.numberToken();
+                auto value = decodeNumber(token);
+                if (!value || value->is_discarded()) return false;
+                reference["refr_index"] = std::move(*value);
+                reference["refr_index_offset"] = static_cast<size_t>(token->data() - jsonText.data());
+                reference["refr_index_length"] = token->size();
+                return true;
+            }
+            if (key == "mast_index") {
+                auto value = decodeNumber(scanner.numberToken());
+                if (!value || value->is_discarded()) return false;
+                reference["mast_index"] = std::move(*value);
+                return true;
+            }
+            if (key == "id") {
+                auto value = decodeString(scanner.stringToken());
+                if (!value || value->is_discarded()) return false;
+                reference["id"] = std::move(*value);
+                return true;
+            }
+            return scanner.skipValue();
+            });
+        };
+
+    // Top-level members: only the type, the header description, the cell name and data and the cell references are kept
+    auto scanElement = [&](ordered_json& element) {
+        return scanner.scanObject([&](std::string_view key) {
+            // The cell name and grid label the cell in the replacement report
+            if ((key == "id" || key == "data") && element.value("type", "") == "Cell") {
+                const size_t start = scanner.position();
+                if (!scanner.skipValue()) return false;
+                auto value = ordered_json::parse(jsonText.substr(start, scanner.position() - start), nullptr, false);
+                if (value.is_discarded()) return false;
+                element[std::string(key)] = std::move(value);
+                return true;
+            }
+            if (key == "type" || key == "description") {
+                auto token = scanner.stringToken();
+                auto value = decodeString(token);
+                if (!value || value->is_discarded()) return false;
+                element[std::string(key)] = std::move(*value);
+                if (key == "description") {
+                    element["description_offset"] = static_cast<size_t>(token->data() - jsonText.data());
+                    element["description_length"] = token->size();
+                }
+                return true;
+            }
+            if (key == "references" && scanner.peek('[')) {
+                ordered_json& references = element["references"] = ordered_json::array();
+                return scanner.scanArray([&]() {
+                    if (!scanner.peek('{')) return scanner.skipValue();
+                    ordered_json reference = ordered_json::object();
+                    if (!scanReference(reference)) return false;
+                    references.push_back(std::move(reference));
+                    return true;
+                    });
+            }
+            return scanner.skipValue();
+            });
+        };
+
+    const bool scanned = scanner.scanArray([&]() {
+        if (!scanner.peek('{')) return scanner.skipValue();
+
+        ordered_json element = ordered_json::object();
+        if (!scanElement(element)) return false;
+
+        const std::string type = element.value("type", "");
+        if (type == "Header" || type == "Cell") {
+            pluginData.push_back(std::move(element));
+        }
+        return true;
+        });
+
+    if (!scanned) {
+        logMessage("ERROR - failed to scan .JSON at byte " + std::to_string(scanner.position()), logFile);
+        return std::nullopt;
+    }
+
+    return pluginData;
+}
+
+// Function to write the scanned .JSON text with only the changed refr_index numbers and the header description replaced
+bool spliceJsonFile(std::string_view jsonText, const ordered_json& pluginData, const std::filesystem::path& outputPath,
+    LogSink& logFile) {
+    std::vector<TextSplice> splices;
+
+    for (const auto& element : pluginData) {
+        if (element.contains("description_offset")) {
+            std::string description = ordered_json(element["description"]).dump();
+            const size_t offset = element["description_offset"];
+            const size_t length = element["description_length"];
+            if (jsonText.substr(offset, length) != description) {
+                splices.push_back({ offset, length, std::move(description) });
+            }
+        }
+
+        if (!element.contains("references")) continue;
+
+        for (const auto& reference : element["references"]) {
+            if (!reference.contains("refr_index_offset")) continue;
+
+            std::string refrIndex = reference["refr_index"].dump();
+            const size_t offset = reference["refr_index_offset"];
+            const size_t length = reference["refr_index_length"];
+            if (jsonText.substr(offset, length) != refrIndex) {
+                splices.push_back({ offset, length, std::move(refrIndex) });
+            }
+        }
+    }
+
+    std::sort(splices.begin(), splices.end(), [](const TextSplice& a, const TextSplice& b) {
+        return a.offset < b.offset;
+        });
+
+    // Unchanged spans point into the original text, replacements into the splices
+    std::vector<std::string_view> pieces;
+    pieces.reserve(splices.size() * 2 + 1);
+    size_t position = 0;
+    for (const auto& splice : splices) {
+        pieces.push_back(jsonText.substr(position, splice.offset - position));
+        pieces.push_back(splice.text);
+        position = splice.offset + splice.length;
+    }
+    pieces.push_back(jsonText.substr(position));
+
+    if (!writePieces(outputPath, pieces)) {
+        logMessage("ERROR - failed to write .JSON file: " + outputPath.string(), logFile);
+        return false;
+    }
+
+    return true;
+}
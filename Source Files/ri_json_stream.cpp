@@ -0,0 +1,170 @@
+#include <fstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "ri_json_stream.h"
+#include "ri_mapped_file.h"
+
+namespace {
+    // SAX handler that materializes the elements of the top-level array one by one
+    class ArrayElementReader {
+    public:
+        using number_integer_t = ordered_json::number_integer_t;
+        using number_unsigned_t = ordered_json::number_unsigned_t;
+        using number_float_t = ordered_json::number_float_t;
+        using string_t = ordered_json::string_t;
+        using binary_t = ordered_json::binary_t;
+
+        explicit ArrayElementReader(std::function<bool(ordered_json&)> onElement) : onElement_(std::move(onElement)) {}
+
+        bool null() { return addValue(nullptr); }
+        bool boolean(bool value) { return addValue(value); }
+        bool number_integer(number_integer_t value) { return addValue(value); }
+        bool number_unsigned(number_unsigned_t value) { return addValue(value); }
+        bool number_float(number_float_t value, const string_t&) { return addValue(value); }
+        bool string(string_t& value) { return addValue(std::move(value)); }
+        bool binary(binary_t& value) { return addValue(ordered_json::binary(std::move(value))); }
+
+        bool start_object(size_t) { return openContainer(ordered_json::object()); }
+        bool end_object() { return closeContainer(); }
+
+        bool start_array(size_t) {
+            if (!insideArray_) {
+                insideArray_ = true;
+                return true;
+            }
+            return openContainer(ordered_json::array());
+        }
+
+        bool end_array() {
+            if (stack_.empty()) {
+                finished_ = true;
+                return true;
+            }
+            return closeContainer();
+        }
+
+        bool key(string_t& name) {
+            key_ = std::move(name);
+            return true;
+        }
+
+        bool parse_error(size_t position, const std::string&, const nlohmann::detail::exception& e) {
+            error_ = "at byte " + std::to_string(position) + ": " + e.what();
+            return false;
+        }
+
+        // Whether the whole top-level array was read
+        bool finished() const { return finished_; }
+
+        // Description of the failure, empty if the element callback stopped the parser
+        const std::string& error() const { return error_; }
+
+    private:
+        // Store a value in the current container, or hand it over if it is a complete top-level element
+        template <typename Value>
+        bool addValue(Value&& value) {
+            if (!insideArray_) {
+                error_ = "input JSON is not an array";
+                return false;
+            }
+            if (stack_.empty()) {
+                element_ = std::forward<Value>(value);
+                return onElement_(element_);
+            }
+            insert(std::forward<Value>(value));
+            return true;
+        }
+
+        bool openContainer(ordered_json container) {
+            if (!insideArray_) {
+                error_ = "input JSON is not an array";
+                return false;
+            }
+            if (stack_.empty()) {
+                element_ = std::move(container);
+                stack_.push_back(&element_);
+            }
+            else {
+                // Parents do not grow while a child is open, so the child pointer stays valid
+                stack_.push_back(&insert(std::move(container)));
+            }
+            return true;
+        }
+
+        bool closeContainer() {
+            stack_.pop_back();
+            return !stack_.empty() || onElement_(element_);
+        }
+
+        template <typename Value>
+        ordered_json& insert(Value&& value) {
+            ordered_json& parent = *stack_.back();
+            if (parent.is_object()) {
+                return parent[key_] = std::forward<Value>(value);
+            }
+            parent.push_back(std::forward<Value>(value));
+            return parent.back();
+        }
+
+        std::function<bool(ordered_json&)> onElement_;
+        ordered_json element_;
+        std::vector<ordered_json*> stack_;
+        string_t key_;
+        bool insideArray_ = false;
+        bool finished_ = false;
+        std::string error_;
+    };
+}
+
+// Function to rewrite a .JSON file holding a top-level array one element at a time
+bool streamJsonArray(const std::filesystem::path& inputPath, const std::filesystem::path& outputPath,
+    const std::function<bool(ordered_json&)>& processElement, LogSink& logFile) {
+
+    std::ofstream outputFile(outputPath, std::ios::binary | std::ios::trunc);
+    if (!outputFile) {
+        logMessage("ERROR - failed to create .JSON file: " + outputPath.string(), logFile);
+        return false;
+    }
+
+    // Elements are written compactly, like the .JSON saved from the whole document
+    size_t elementCount = 0;
+    auto onElement = [&](ordered_json& element) {
+        if (!processElement(element)) return false;
+
+        outputFile << (elementCount == 0 ? '[' : ',') << element;
+
+        ++elementCount;
+        return static_cast<bool>(outputFile);
+        };
+
+    ArrayElementReader reader(onElement);
+    try {
+        MappedFile inputFile(inputPath);
+        const std::string_view inputText = inputFile.view();
+        ordered_json::sax_parse(inputText.begin(), inputText.end(), &reader);
+    }
+    catch (const std::exception& e) {
+        logMessage("ERROR - failed to parse JSON (" + inputPath.string() + "): " + e.what(), logFile);
+        return false;
+    }
+
+    if (!reader.finished()) {
+        if (!reader.error().empty()) {
+            logMessage("ERROR - failed to parse JSON (" + inputPath.string() + "): " + reader.error(), logFile);
+        }
+        else if (!outputFile) {
+            logMessage("ERROR - failed to write .JSON file: " + outputPath.string(), logFile);
+        }
+        return false;
+    }
+
+    outputFile << (elementCount == 0 ? "[]" : "]");
+    if (!outputFile.flush()) {
+        logMessage("ERROR - failed to write .JSON file: " + outputPath.string(), logFile);
+        return false;
+    }
+
+    return true;
+}
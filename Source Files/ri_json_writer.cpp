@@ -0,0 +1,77 @@
+#include <fstream>
+#include <streambuf>
+#include <vector>
+
+#include "ri_json_writer.h"
+
+namespace {
+    constexpr size_t WRITE_BUFFER_SIZE = 1 << 20;
+
+    // Stream buffer that collects the serializer output in a caller-owned buffer and passes it to the file in
+    // whole blocks. Unlike basic_filebuf::setbuf, this behaves the same with every standard library
+    class BlockWriteBuffer : public std::streambuf {
+    public:
+        BlockWriteBuffer(std::ofstream& file, std::vector<char>& buffer) : file_(file) {
+            setp(buffer.data(), buffer.data() + buffer.size());
+        }
+
+        // Total number of bytes passed to the file so far
+        size_t written() const { return written_; }
+
+    protected:
+        int_type overflow(int_type ch) override {
+            if (!writeBlock()) return traits_type::eof();
+            if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+                *pptr() = traits_type::to_char_type(ch);
+                pbump(1);
+            }
+            return traits_type::not_eof(ch);
+        }
+
+        int sync() override {
+            return writeBlock() && file_.flush() ? 0 : -1;
+        }
+
+    private:
+        bool writeBlock() {
+            const std::streamsize size = pptr() - pbase();
+            if (size > 0 && !file_.write(pbase(), size)) return false;
+            written_ += static_cast<size_t>(size);
+            setp(pbase(), epptr());
+            return true;
+        }
+
+        std::ofstream& file_;
+        size_t written_ = 0;
+    };
+}
+
+// Function to write JSON data to a file in compact form, through a reusable 1 MiB buffer
+std::optional<size_t> writeCompactJson(const std::filesystem::path& outputPath, const ordered_json& data, LogSink& logFile) {
+    // One buffer per thread, kept between files
+    thread_local std::vector<char> buffer(WRITE_BUFFER_SIZE);
+
+    std::ofstream outputFile(outputPath, std::ios::binary | std::ios::trunc);
+    if (!outputFile) {
+        logMessage("ERROR - failed to create .JSON file: " + outputPath.string(), logFile);
+        return std::nullopt;
+    }
+
+    // The serializer fills the buffer, the file receives it in 1 MiB blocks
+    BlockWriteBuffer blockBuffer(outputFile, buffer);
+    std::ostream output(&blockBuffer);
+    try {
+        output << data;
+    }
+    catch (const std::exception& e) {
+        logMessage("ERROR - failed to serialize JSON (" + outputPath.string() + "): " + e.what(), logFile);
+        return std::nullopt;
+    }
+
+    if (!output.flush() || !outputFile) {
+        logMessage("ERROR - failed to write .JSON file: " + outputPath.string(), logFile);
+        return std::nullopt;
+    }
+
+    return blockBuffer.written();
+}
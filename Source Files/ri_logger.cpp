@@ -1,14 +1,159 @@
 #include <iostream>
 #include <fstream>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cstdlib>
+#include <future>
 #include <limits>
+#include <string>
+#include <thread>
+#include <vector>
 
 #include "ri_logger.h"
 
+namespace {
+    // Background writer of log messages: producers push onto a lock-free stack, the writer thread takes the whole
+    // stack at once and writes it in push order without flushing. The streams are flushed only on request
+    class AsyncLogWriter {
+    public:
+        AsyncLogWriter() : thread_([this] { run(); }) {}
+
+        ~AsyncLogWriter() {
+            push(new Entry(EntryKind::Stop));
+            thread_.join();
+        }
+
+        // Queue text for the console and the log file
+        void write(std::string text, std::ofstream& logFile) {
+            push(new Entry(EntryKind::Text, std::move(text), &logFile));
+        }
+
+        // Wait until everything queued so far is written and the streams are flushed
+        void flush() {
+            auto* entry = new Entry(EntryKind::Flush);
+            std::future<void> done = entry->done.get_future();
+            push(entry);
+            done.wait();
+        }
+
+    private:
+        enum class EntryKind { Text, Flush, Stop };
+
+        struct Entry {
+            explicit Entry(EntryKind kind, std::string text = {}, std::ofstream* logFile = nullptr)
+                : kind(kind), text(std::move(text)), logFile(logFile) {}
+
+            EntryKind kind;
+            std::string text;
+            std::ofstream* logFile;
+            std::promise<void> done;  // Set once a flush entry is processed
+            Entry* next = nullptr;
+        };
+
+        void push(Entry* entry) {
+            Entry* next = head_.load(std::memory_order_relaxed);
+            do {
+                entry->next = next;
+            } while (!head_.compare_exchange_weak(next, entry, std::memory_order_release, std::memory_order_relaxed));
+
+            // The writer only sleeps on an empty stack. Once pushed, the entry may already be written and deleted,
+            // so only the local copy of the previous head is read here
+            if (!next) head_.notify_one();
+        }
+
+        void run() {
+            std::vector<std::ofstream*> unflushedFiles;
+
+            while (true) {
+                Entry* batch = head_.exchange(nullptr, std::memory_order_acquire);
+                if (!batch) {
+                    head_.wait(nullptr, std::memory_order_acquire);
+                    continue;
+                }
+
+                // The stack holds the newest entry first
+                Entry* ordered = nullptr;
+                while (batch) {
+                    Entry* next = batch->next;
+                    batch->next = ordered;
+                    ordered = batch;
+                    batch = next;
+                }
+
+                bool stop = false;
+                bool flushed = false;
+                while (ordered) {
+                    Entry* entry = ordered;
+                    ordered = entry->next;
+
+                    switch (entry->kind) {
+                    case EntryKind::Text:
+                        std::cout << entry->text;
+                        *entry->logFile << entry->text;
+                        if (std::find(unflushedFiles.begin(), unflushedFiles.end(), entry->logFile) == unflushedFiles.end()) {
+                            unflushedFiles.push_back(entry->logFile);
+                        }
+                        break;
+                    case EntryKind::Flush:
+                        std::cout.flush();
+                        for (std::ofstream* logFile : unflushedFiles) logFile->flush();
+                        unflushedFiles.clear();
+                        entry->done.set_value();
+                        flushed = true;
+                        break;
+                    case EntryKind::Stop:
+                        stop = true;
+                        break;
+                    }
+                    delete entry;
+                }
+
+                if (stop) {
+                    std::cout.flush();
+                    for (std::ofstream* logFile : unflushedFiles) logFile->flush();
+                    return;
+                }
+
+                // Let messages pile up, so the writer wakes up once per batch instead of once per message
+                if (!flushed) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }
+
+        std::atomic<Entry*> head_ = nullptr;
+        std::thread thread_;
+    };
+
+    AsyncLogWriter& logWriter() {
+        static AsyncLogWriter writer;
+        return writer;
+    }
+}
+
+void LogSink::write(const std::string& message) {
+    if (buffered_) {
+        buffer_ += message;
+        buffer_ += '\n';
+        return;
+    }
+
+    logWriter().write(message + '\n', logFile_);
+
+    // Errors reach the console and the file at once, so they are not lost if the process dies before the next flush
+    if (message.starts_with("ERROR")) logWriter().flush();
+}
+
+void LogSink::flush() {
+    if (!buffer_.empty()) {
+        logWriter().write(std::move(buffer_), logFile_);
+        buffer_.clear();
+    }
+    logWriter().flush();
+}
+
 // Function to log messages to both a log file and console
-void logMessage(const std::string& message, std::ofstream& logFile) {
-    std::cout << message << std::endl;
-    logFile << message << std::endl;
+void logMessage(const std::string& message, LogSink& logFile) {
+    logFile.write(message);
 }
 
 // Function to clear log file
@@ -18,10 +163,11 @@ void logClear() {
 }
 
 // Function to log errors, close the database and terminate the program
-[[noreturn]] void logErrorAndExit(const std::string& errorMessage, std::ofstream& logFile) {
+[[noreturn]] void logErrorAndExit(const std::string& errorMessage, LogSink& logFile) {
+    logFile.flush();
     std::cerr << errorMessage;
-    logFile << errorMessage;
-    logFile.close();
+    logFile.file() << errorMessage;
+    logFile.file().close();
 
 #ifndef __linux__
     std::cout << "\nPress Enter to exit...";
@@ -1,15 +1,29 @@
 #include <algorithm>
+#include <cctype>
 #include <cstdlib>
 #include <iostream>
 #include <limits>
+#include <thread>
 
 #include "ri_options.h"
 #include "ri_mismatches.h"
 
-// Global data structures for validation and mismatch tracking:
-std::unordered_set<int> validMastersIn;               // Valid master indices from input
-std::unordered_set<int> validMastersDb;               // Valid master indices from database
-std::unordered_set<MismatchEntry> mismatchedEntries;  // Collection of mismatched records
+namespace {
+    // Function to take the value of a flag from the next argument, exits if the flag is the last argument
+    std::string takeValue(int argc, char* argv[], int& i, const std::string& arg) {
+        if (i + 1 >= argc) {
+            std::cerr << "ERROR - missing value for " << arg << "\n";
+            std::exit(EXIT_FAILURE);
+        }
+        return argv[++i];
+    }
+
+    // Function to check that a value is a non-negative number of at most maxDigits digits
+    bool isNumber(const std::string& value, size_t maxDigits) {
+        return !value.empty() && value.size() <= maxDigits &&
+            std::all_of(value.begin(), value.end(), [](unsigned char c) { return std::isdigit(c) != 0; });
+    }
+}
 
 // Function to parse command-line arguments
 ProgramOptions parseArguments(int argc, char* argv[]) {
@@ -26,6 +40,62 @@ ProgramOptions parseArguments(int argc, char* argv[]) {
         else if (argLower == "--silent" || argLower == "-s") {
             options.silentMode = true;
         }
+        else if (argLower == "--in-place" || argLower == "-i") {
+            options.inPlace = true;
+        }
+        else if (argLower == "--tes3conv" || argLower == "-t") {
+            options.useTes3conv = true;
+        }
+        else if (argLower == "--summary") {
+            options.summaryMode = true;
+        }
+        else if (argLower == "--pipeline") {
+            options.pipeline = true;
+        }
+        else if (argLower == "--splice") {
+            options.spliceJson = true;
+        }
+        else if (argLower == "--stream") {
+            options.streamJson = true;
+        }
+        else if (argLower == "--preload" || argLower == "-p") {
+            options.preloadDb = true;
+        }
+        else if (argLower == "--report") {
+            options.reportPath = takeValue(argc, argv, i, arg);
+        }
+        else if (argLower == "--trace") {
+            options.tracePath = takeValue(argc, argv, i, arg);
+        }
+        else if (argLower == "--jobs" || argLower == "-j") {
+            // 0 - one job per hardware thread
+            std::string jobs = takeValue(argc, argv, i, arg);
+            if (!isNumber(jobs, 4)) {
+                std::cerr << "ERROR - invalid number of jobs: " << jobs << "\n";
+                std::exit(EXIT_FAILURE);
+            }
+            options.jobs = static_cast<unsigned>(std::stoul(jobs));
+            if (options.jobs == 0) {
+                options.jobs = std::max(1u, std::thread::hardware_concurrency());
+            }
+        }
+        else if (argLower == "--memory-budget") {
+            // Megabytes, 0 - no limit
+            std::string budget = takeValue(argc, argv, i, arg);
+            if (!isNumber(budget, 7)) {
+                std::cerr << "ERROR - invalid memory budget: " << budget << "\n";
+                std::exit(EXIT_FAILURE);
+            }
+            options.memoryBudget = static_cast<unsigned>(std::stoul(budget));
+        }
+        else if (argLower == "--procs" || argLower == "--timeout") {
+            std::string value = takeValue(argc, argv, i, arg);
+            if (!isNumber(value, 5)) {
+                std::cerr << "ERROR - invalid value for " << arg << ": " << value << "\n";
+                std::exit(EXIT_FAILURE);
+            }
+            (argLower == "--procs" ? options.maxProcesses : options.tes3convTimeout) = static_cast<unsigned>(std::stoul(value));
+        }
         else if (argLower == "--ru-to-en" || argLower == "-1") {
             options.conversionType = 1;
         }
@@ -45,8 +115,24 @@ ProgramOptions parseArguments(int argc, char* argv[]) {
                       << "Options:\n"
                       << "  -b, --batch      Enable batch mode (required when processing multiple files)\n"
                       << "  -s, --silent     Suppress non-critical messages (faster conversion)\n"
+                      << "      --summary    Log replacements per cell, details of each reference go to <file>.ri_report.tsv\n"
                       << "  -1, --ru-to-en   Convert Russian 1C -> English GOTY\n"
                       << "  -2, --en-to-ru   Convert English GOTY -> Russian 1C\n"
+                      << "  -i, --in-place   Patch files in place without creating a backup\n"
+                      << "  -t, --tes3conv   Re-encode converted files through tes3conv instead of patching them\n"
+                      << "  -p, --preload    Load the refr_index database into memory before converting\n"
+                      << "  -j, --jobs N     Convert up to N files at the same time in batch mode (0 - one per CPU core)\n"
+                      << "      --stream     Process tes3conv .JSON one cell at a time to limit memory use on huge masters\n"
+                      << "      --splice     Rewrite only the changed numbers of tes3conv .JSON (takes precedence over --stream)\n"
+                      << "      --pipeline   Overlap the conversion stages of consecutive files in batch mode (-j workers per stage)\n"
+                      << "      --procs N    Run at most N tes3conv processes at the same time (0 - no limit)\n"
+                      << "      --timeout S  Stop tes3conv after S seconds and skip the file (0 - no timeout)\n"
+                      << "      --memory-budget MB\n"
+                      << "                   Start parallel files only while their estimated memory fits in MB (0 - no limit).\n"
+                      << "                   Estimate: 4x the file size, up to 32x for files converted through tes3conv\n"
+                      << "      --report FILE\n"
+                      << "                   Save the step timings, sizes and counts of each file as .JSON\n"
+                      << "      --trace FILE Save the stages of each file and the tes3conv runs as a Chrome trace (Perfetto)\n"
                       << "  -h, --help       Show this help message\n\n"
                       << "Target Formats:\n\n"
                       << "  Single File (works without batch mode):\n"
@@ -0,0 +1,156 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "ri_file_processor.h"
+#include "ri_logger.h"
+#include "ri_mapped_file.h"
+#include "ri_plugin_patcher.h"
+
+namespace {
+    // Size of the fixed-width HEDR description field
+    constexpr size_t HEDR_DESCRIPTION_SIZE = 256;
+
+    // Bytes to overwrite at a given file offset
+    struct BytePatch {
+        size_t offset;
+        std::string bytes;
+    };
+
+    // Encode a 32-bit value as little-endian bytes
+    std::string encodeU32(uint32_t value) {
+        std::string bytes(sizeof(value), '\0');
+        std::memcpy(bytes.data(), &value, sizeof(value));
+        return bytes;
+    }
+
+    // Collect FRMR (and MVRF) values that differ from the original file
+    void collectReferencePatches(const ordered_json& pluginData, std::string_view buffer, std::vector<BytePatch>& patches) {
+        for (const auto& cell : pluginData) {
+            if (!cell.contains("references") || !cell["references"].is_array()) continue;
+
+            for (const auto& reference : cell["references"]) {
+                if (!reference.contains("frmr_offset")) continue;
+
+                const size_t frmrOffset = reference["frmr_offset"];
+                if (frmrOffset + sizeof(uint32_t) > buffer.size()) continue;
+
+                const uint32_t frmr = (reference["mast_index"].get<uint32_t>() << 24) |
+                                      (reference["refr_index"].get<uint32_t>() & 0x00FFFFFF);
+                if (std::memcmp(buffer.data() + frmrOffset, &frmr, sizeof(frmr)) == 0) continue;
+
+                patches.push_back({ frmrOffset, encodeU32(frmr) });
+                if (reference.contains("mvrf_offset")) {
+                    patches.push_back({ reference["mvrf_offset"].get<size_t>(), encodeU32(frmr) });
+                }
+            }
+        }
+    }
+
+    // Append the conversion tag to the raw HEDR description, trimming the old text if the tag would not fit
+    bool collectDescriptionPatch(const ordered_json& pluginData, std::string_view buffer, const std::string& convPrefix,
+        std::vector<BytePatch>& patches, LogSink& logFile) {
+        const auto& header = pluginData.front();
+        if (!header.contains("description_offset")) return false;
+
+        const size_t descOffset = header["description_offset"];
+        if (descOffset + HEDR_DESCRIPTION_SIZE > buffer.size()) return false;
+
+        std::string description(buffer.substr(descOffset, HEDR_DESCRIPTION_SIZE));
+        description.resize(std::min(description.find('\0'), HEDR_DESCRIPTION_SIZE));
+
+        const std::string conversionTag = makeConversionTag(convPrefix);
+        if (description.find(conversionTag) != std::string::npos) return true;
+
+        // Keep at least one null terminator in the field. Cutting the author's text is logged in silent mode as well
+        const size_t maxLength = HEDR_DESCRIPTION_SIZE - 1 - conversionTag.size();
+        if (description.size() > maxLength) {
+            logWarning(logFile, "header description trimmed by {} characters to fit the conversion tag", description.size() - maxLength);
+            description.resize(maxLength);
+        }
+
+        description += conversionTag;
+        description.resize(HEDR_DESCRIPTION_SIZE, '\0');
+        patches.push_back({ descOffset, description });
+        return true;
+    }
+}
+
+// Function to write the changed refr_index values and the conversion tag into the .ESP|ESM bytes
+bool patchPluginFile(const std::filesystem::path& sourcePath, const std::filesystem::path& targetPath,
+    const ordered_json& pluginData, const std::string& convPrefix, const ProgramOptions& options, LogSink& logFile) {
+    std::vector<BytePatch> patches;
+    size_t referencePatches = 0;
+
+    try {
+        MappedFile sourceFile(sourcePath);
+        const std::string_view source = sourceFile.view();
+
+        collectReferencePatches(pluginData, source, patches);
+        referencePatches = patches.size();
+
+        if (!collectDescriptionPatch(pluginData, source, convPrefix, patches, logFile)) {
+            logMessage("ERROR - could not find or modify header description\n", logFile);
+            return false;
+        }
+
+        // Write the patched copy straight from the mapping: unchanged spans are written as they are
+        if (sourcePath != targetPath) {
+            std::sort(patches.begin(), patches.end(), [](const BytePatch& a, const BytePatch& b) {
+                return a.offset < b.offset;
+                });
+
+            std::ofstream targetFile(targetPath, std::ios::binary | std::ios::trunc);
+            size_t position = 0;
+            for (const auto& patch : patches) {
+                targetFile.write(source.data() + position, static_cast<std::streamsize>(patch.offset - position));
+                targetFile.write(patch.bytes.data(), static_cast<std::streamsize>(patch.bytes.size()));
+                position = patch.offset + patch.bytes.size();
+            }
+            targetFile.write(source.data() + position, static_cast<std::streamsize>(source.size() - position));
+
+            if (!targetFile.flush()) {
+                logMessage("ERROR - failed to write patched file: " + targetPath.string(), logFile);
+                return false;
+            }
+        }
+    }
+    catch (const std::exception& e) {
+        logMessage("ERROR - failed to patch file " + targetPath.string() + ": " + e.what(), logFile);
+        return false;
+    }
+
+    // Overwrite only the patched bytes of the original file, once its mapping is released
+    if (sourcePath == targetPath) {
+        std::fstream pluginFile(targetPath, std::ios::binary | std::ios::in | std::ios::out);
+        if (!pluginFile.is_open()) {
+            logMessage("ERROR - failed to open file for patching: " + targetPath.string(), logFile);
+            return false;
+        }
+
+        for (const auto& patch : patches) {
+            pluginFile.seekp(static_cast<std::streamoff>(patch.offset));
+            pluginFile.write(patch.bytes.data(), static_cast<std::streamsize>(patch.bytes.size()));
+        }
+
+        if (!pluginFile.flush()) {
+            logMessage("ERROR - failed to write patched file: " + targetPath.string(), logFile);
+            return false;
+        }
+    }
+
+    if (!options.silentMode) {
+        logMessage("Patched " + std::to_string(referencePatches) + " FRMR|MVRF values", logFile);
+    }
+
+    logMessage("Patching of .ESP|ESM successful: " + targetPath.string(), logFile);
+
+    if (options.silentMode) {
+        logMessage("", logFile);
+    }
+
+    return true;
+}
@@ -0,0 +1,193 @@
+#include <array>
+#include <string_view>
+
+#include "ri_logger.h"
+#include "ri_mapped_file.h"
+#include "ri_plugin_reader.h"
+#include "ri_record_view.h"
+
+namespace {
+    // Layout of the fixed-width HEDR description field
+    constexpr size_t HEDR_DESCRIPTION_OFFSET = 40;
+    constexpr size_t HEDR_DESCRIPTION_SIZE = 256;
+
+    // Decode a Windows-1252 string to UTF-8, the same way tes3conv does
+    std::string decodeString(std::string_view text) {
+        // Characters 0x80-0x9F of Windows-1252 that differ from Latin-1
+        static constexpr std::array<char16_t, 32> cp1252 = {
+            0x20AC, 0x0081, 0x201A, 0x0192, 0x201E, 0x2026, 0x2020, 0x2021,
+            0x02C6, 0x2030, 0x0160, 0x2039, 0x0152, 0x008D, 0x017D, 0x008F,
+            0x0090, 0x2018, 0x2019, 0x201C, 0x201D, 0x2022, 0x2013, 0x2014,
+            0x02DC, 0x2122, 0x0161, 0x203A, 0x0153, 0x009D, 0x017E, 0x0178
+        };
+
+        std::string result;
+        result.reserve(text.size());
+        for (unsigned char c : text) {
+            if (c < 0x80) {
+                result += static_cast<char>(c);
+                continue;
+            }
+
+            char16_t code = (c < 0xA0) ? cp1252[c - 0x80] : static_cast<char16_t>(c);
+            if (code < 0x800) {
+                result += static_cast<char>(0xC0 | (code >> 6));
+            }
+            else {
+                result += static_cast<char>(0xE0 | (code >> 12));
+                result += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+            }
+            result += static_cast<char>(0x80 | (code & 0x3F));
+        }
+        return result;
+    }
+
+    // Build the Header object from the TES3 record, the file offset of the HEDR description is kept for patching
+    bool readHeader(const RecordView& record, ordered_json& header) {
+        header = { {"type", "Header"}, {"description", ""}, {"masters", ordered_json::array()} };
+
+        SubrecordReader subrecords(record);
+        for (SubrecordView subrecord; subrecords.next(subrecord);) {
+            if (subrecord.tag == "HEDR" && subrecord.data.size() >= HEDR_DESCRIPTION_OFFSET + HEDR_DESCRIPTION_SIZE) {
+                std::string_view description = subrecord.data.substr(HEDR_DESCRIPTION_OFFSET, HEDR_DESCRIPTION_SIZE);
+                header["description"] = decodeString(description.substr(0, description.find('\0')));
+                header["description_offset"] = subrecord.offset + HEDR_DESCRIPTION_OFFSET;
+            }
+            else if (subrecord.tag == "MAST") {
+                header["masters"].push_back(ordered_json::array({ decodeString(subrecord.text()), 0 }));
+            }
+            else if (subrecord.tag == "DATA" && subrecord.data.size() >= 8 && !header["masters"].empty()) {
+                header["masters"].back()[1] = readU64(subrecord.data.data());
+            }
+        }
+        return !subrecords.malformed();
+    }
+
+    // Build a Cell object with its references from the CELL record, the file offsets of FRMR values are kept for patching
+    bool readCell(const RecordView& record, ordered_json& cell) {
+        cell = { {"type", "Cell"}, {"id", ""}, {"data", ordered_json::object()}, {"references", ordered_json::array()} };
+        auto& references = cell["references"];
+        ordered_json* reference = nullptr;
+
+        // Last MVRF not yet matched with its FRMR
+        bool hasMovedReference = false;
+        uint32_t movedReferenceValue = 0;
+        size_t movedReferenceOffset = 0;
+
+        SubrecordReader subrecords(record);
+        for (SubrecordView subrecord; subrecords.next(subrecord);) {
+            // A moved reference repeats its FRMR value in the MVRF that precedes it
+            if (subrecord.tag == "MVRF" && subrecord.data.size() >= 4) {
+                hasMovedReference = true;
+                movedReferenceValue = subrecord.u32();
+                movedReferenceOffset = subrecord.offset;
+            }
+            // Each reference starts with FRMR: master index in the high byte, refr_index in the low 24 bits
+            else if (subrecord.tag == "FRMR" && subrecord.data.size() >= 4) {
+                const uint32_t frmr = subrecord.u32();
+                references.push_back({ {"mast_index", frmr >> 24}, {"refr_index", frmr & 0x00FFFFFF}, {"id", ""},
+                                       {"frmr_offset", subrecord.offset} });
+                reference = &references.back();
+
+                if (hasMovedReference && movedReferenceValue == frmr) {
+                    (*reference)["mvrf_offset"] = movedReferenceOffset;
+                }
+                hasMovedReference = false;
+            }
+            else if (subrecord.tag == "NAME") {
+                (reference ? (*reference)["id"] : cell["id"]) = decodeString(subrecord.text());
+            }
+            else if (subrecord.tag == "DATA" && !reference && subrecord.data.size() >= 12) {
+                cell["data"] = { {"flags", subrecord.u32()},
+                                 {"grid", { static_cast<int32_t>(subrecord.u32(4)), static_cast<int32_t>(subrecord.u32(8)) }} };
+            }
+        }
+        return !subrecords.malformed();
+    }
+}
+
+// Function to read the header, cells and references of a .ESP|ESM file directly from its binary records
+std::optional<ordered_json> readPluginFile(const std::filesystem::path& pluginPath, LogSink& logFile) {
+    std::optional<MappedFile> pluginFile;
+    try {
+        pluginFile.emplace(pluginPath);
+    }
+    catch (const std::exception& e) {
+        logMessage(std::string("ERROR - ") + e.what(), logFile);
+        return std::nullopt;
+    }
+
+    ordered_json pluginData = ordered_json::array();
+    RecordReader records(pluginFile->view());
+
+    for (RecordView record; records.next(record);) {
+        // The TES3 header must be the first record
+        if (pluginData.empty() && record.tag != "TES3") break;
+
+        bool isValid = true;
+        if (record.tag == "TES3") {
+            isValid = readHeader(record, pluginData.emplace_back());
+        }
+        else if (record.tag == "CELL") {
+            isValid = readCell(record, pluginData.emplace_back());
+        }
+
+        if (!isValid) {
+            logMessage("ERROR - malformed " + std::string(record.tag) + " record in file: " + pluginPath.string(), logFile);
+            return std::nullopt;
+        }
+    }
+
+    if (records.malformed()) {
+        logMessage("ERROR - truncated record in file: " + pluginPath.string(), logFile);
+        return std::nullopt;
+    }
+
+    if (pluginData.empty()) {
+        logMessage("ERROR - missing TES3 header in file: " + pluginPath.string(), logFile);
+        return std::nullopt;
+    }
+
+    return pluginData;
+}
+
+// Function to read only the TES3 header record of a .ESP|ESM file
+std::optional<ordered_json> readPluginHeader(const std::filesystem::path& pluginPath, LogSink& logFile) {
+    std::ifstream pluginFile(pluginPath, std::ios::binary);
+    if (!pluginFile.is_open()) {
+        logMessage("ERROR - failed to open file: " + pluginPath.string(), logFile);
+        return std::nullopt;
+    }
+
+    // Read the record header, then just the body of the TES3 record
+    std::string headerRecord(RECORD_HEADER_SIZE, '\0');
+    if (!pluginFile.read(headerRecord.data(), RECORD_HEADER_SIZE) || headerRecord.compare(0, 4, "TES3") != 0) {
+        logMessage("ERROR - missing TES3 header in file: " + pluginPath.string(), logFile);
+        return std::nullopt;
+    }
+
+    // The record size comes from the file, so it is checked against the file before anything is allocated
+    const size_t size = readU32(headerRecord.data() + 4);
+    std::error_code ec;
+    const uintmax_t fileSize = std::filesystem::file_size(pluginPath, ec);
+    if (ec || size > fileSize - RECORD_HEADER_SIZE) {
+        logMessage("ERROR - truncated record in file: " + pluginPath.string(), logFile);
+        return std::nullopt;
+    }
+
+    headerRecord.resize(RECORD_HEADER_SIZE + size);
+    if (!pluginFile.read(headerRecord.data() + RECORD_HEADER_SIZE, static_cast<std::streamsize>(size))) {
+        logMessage("ERROR - truncated record in file: " + pluginPath.string(), logFile);
+        return std::nullopt;
+    }
+
+    RecordView record;
+    RecordReader records(headerRecord);
+    ordered_json pluginHeader = ordered_json::array();
+    if (!records.next(record) || !readHeader(record, pluginHeader.emplace_back())) {
+        logMessage("ERROR - malformed TES3 record in file: " + pluginPath.string(), logFile);
+        return std::nullopt;
+    }
+
+    return pluginHeader;
+}
@@ -0,0 +1,89 @@
+#include <algorithm>
+#include <bit>
+#include <stdexcept>
+
+#include "ri_refr_index_map.h"
+
+namespace {
+    // Spread the bits of a refr_index over the whole hash value
+    size_t hashRefIndex(int refrIndex) {
+        uint64_t value = static_cast<uint32_t>(refrIndex);
+        value ^= value >> 33;
+        value *= 0xff51afd7ed558ccdULL;
+        value ^= value >> 33;
+        return static_cast<size_t>(value);
+    }
+}
+
+RefrIndexMap::RefrIndexMap(sqlite3* db) {
+    sqlite3_stmt* stmt = nullptr;
+    const char* query = "SELECT refr_index_EN, refr_index_RU, ID, Master FROM [tes3_T-B_en-ru_refr_index] ORDER BY rowid;";
+    if (sqlite3_prepare_v2(db, query, -1, &stmt, nullptr) != SQLITE_OK) {
+        sqlite3_finalize(stmt);
+        throw std::runtime_error("ERROR - failed to load refr_index table: " + std::string(sqlite3_errmsg(db)));
+    }
+
+    std::vector<RefrIndexRow> rows;
+    int result;
+    while ((result = sqlite3_step(stmt)) == SQLITE_ROW) {
+        // Rows without both refr_index values can never be matched
+        if (sqlite3_column_type(stmt, 0) == SQLITE_NULL || sqlite3_column_type(stmt, 1) == SQLITE_NULL) continue;
+
+        const unsigned char* id = sqlite3_column_text(stmt, 2);
+        const unsigned char* master = sqlite3_column_text(stmt, 3);
+        rows.push_back({
+            sqlite3_column_int(stmt, 0),
+            sqlite3_column_int(stmt, 1),
+            id ? reinterpret_cast<const char*>(id) : "",
+            master ? parseMasterName(reinterpret_cast<const char*>(master)) : 0 });
+    }
+    sqlite3_finalize(stmt);
+
+    if (result != SQLITE_DONE) {
+        throw std::runtime_error("ERROR - failed to load refr_index table: " + std::string(sqlite3_errmsg(db)));
+    }
+
+    // Keep the load factor at or below one half, so probe sequences stay short
+    const size_t capacity = std::bit_ceil(std::max<size_t>(rows.size() * 2, 16));
+
+    for (int conversionChoice = 1; conversionChoice <= 2; ++conversionChoice) {
+        auto& directionRows = rows_[conversionChoice - 1];
+        auto& index = index_[conversionChoice - 1];
+
+        // A stable sort keeps rows with the same refr_index in table order, so the first match is the same as in SQL
+        directionRows = rows;
+        std::stable_sort(directionRows.begin(), directionRows.end(), [&](const RefrIndexRow& a, const RefrIndexRow& b) {
+            return sourceRefIndex(a, conversionChoice) < sourceRefIndex(b, conversionChoice);
+            });
+
+        index.slots.assign(capacity, 0);
+        index.mask = capacity - 1;
+
+        for (size_t row = 0; row < directionRows.size(); ++row) {
+            const int refrIndex = sourceRefIndex(directionRows[row], conversionChoice);
+            if (row > 0 && sourceRefIndex(directionRows[row - 1], conversionChoice) == refrIndex) continue;
+
+            size_t slot = hashRefIndex(refrIndex) & index.mask;
+            while (index.slots[slot] != 0) slot = (slot + 1) & index.mask;
+            index.slots[slot] = static_cast<uint32_t>(row + 1);
+        }
+    }
+}
+
+std::span<const RefrIndexRow> RefrIndexMap::findRows(int conversionChoice, int refrIndex) const {
+    if (conversionChoice != 1 && conversionChoice != 2) return {};
+
+    const auto& directionRows = rows_[conversionChoice - 1];
+    const auto& index = index_[conversionChoice - 1];
+
+    for (size_t slot = hashRefIndex(refrIndex) & index.mask; index.slots[slot] != 0; slot = (slot + 1) & index.mask) {
+        const size_t first = index.slots[slot] - 1;
+        if (sourceRefIndex(directionRows[first], conversionChoice) != refrIndex) continue;
+
+        size_t last = first + 1;
+        while (last < directionRows.size() && sourceRefIndex(directionRows[last], conversionChoice) == refrIndex) ++last;
+        return { directionRows.data() + first, last - first };
+    }
+
+    return {};
+}
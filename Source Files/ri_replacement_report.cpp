@@ -0,0 +1,117 @@
+#include <algorithm>
+#include <format>
+#include <fstream>
+
+#include "ri_replacement_report.h"
+
+namespace {
+    // Function to get the name of a cell for the report: interiors by name, exteriors by name and grid
+    std::string cellLabel(const ordered_json& cell) {
+        std::string label = cell.value("id", "");
+
+        auto data = cell.find("data");
+        if (data == cell.end() || !data->is_object()) return label.empty() ? "<unnamed>" : label;
+
+        // tes3conv writes the flags as names, the native reader as a number
+        const auto flags = data->find("flags");
+        const bool interior = flags != data->end() &&
+            ((flags->is_number_unsigned() && (flags->get<uint32_t>() & 0x01)) ||
+             (flags->is_string() && flags->get<std::string>().find("INTERIOR") != std::string::npos));
+
+        const auto grid = data->find("grid");
+        if (interior || grid == data->end() || !grid->is_array() || grid->size() != 2) {
+            return label.empty() ? "<unnamed>" : label;
+        }
+
+        if (!label.empty()) label += ' ';
+        return label + std::format("({}, {})", (*grid)[0].get<int>(), (*grid)[1].get<int>());
+    }
+
+    // Function to append a .TSV field, tabs and line breaks inside it are replaced with spaces
+    void appendField(std::string& line, const std::string& field) {
+        const size_t start = line.size();
+        line += field;
+        std::replace_if(line.begin() + static_cast<std::ptrdiff_t>(start), line.end(),
+            [](char c) { return c == '\t' || c == '\r' || c == '\n'; }, ' ');
+    }
+
+    // Function to get the status column of a reference, mismatches not accepted by the end of the file were kept
+    const char* eventName(ReferenceEvent event) {
+        switch (event) {
+        case ReferenceEvent::Replaced: return "replaced";
+        case ReferenceEvent::ReplacedMismatch: return "mismatch_replaced";
+        case ReferenceEvent::Mismatch: break;
+        }
+        return "mismatch_kept";
+    }
+}
+
+void ReplacementReport::record(const ordered_json& cell, ReferenceEvent event, int refrIndexJson, const std::string& idJson,
+    int refrIndexDb, const std::string& idDb) {
+    if (cellStarted_) {
+        cellLabels_.push_back(cellLabel(cell));
+        cellStarted_ = false;
+    }
+    rows_.push_back({ cellLabels_.size() - 1, event, refrIndexJson, idJson, refrIndexDb, idDb });
+}
+
+void ReplacementReport::acceptMismatches() {
+    for (size_t row = unresolvedMismatches_; row < rows_.size(); ++row) {
+        if (rows_[row].event == ReferenceEvent::Mismatch) rows_[row].event = ReferenceEvent::ReplacedMismatch;
+    }
+    unresolvedMismatches_ = rows_.size();
+}
+
+bool ReplacementReport::write(const std::filesystem::path& pluginPath, LogSink& logFile) const {
+    if (rows_.empty()) return true;
+
+    // Counts of each cell: replaced references, including replaced mismatches, and mismatches
+    std::vector<std::pair<size_t, size_t>> cellCounts(cellLabels_.size());
+    size_t replaced = 0;
+    size_t mismatched = 0;
+    for (const Row& row : rows_) {
+        if (row.event != ReferenceEvent::Mismatch) {
+            ++cellCounts[row.cell].first;
+            ++replaced;
+        }
+        if (row.event != ReferenceEvent::Replaced) {
+            ++cellCounts[row.cell].second;
+            ++mismatched;
+        }
+    }
+
+    const std::filesystem::path reportPath = replacementReportPath(pluginPath);
+    std::string text = "cell\tstatus\tjson_refr_index\tjson_id\tdb_refr_index\tdb_id\n";
+    for (const Row& row : rows_) {
+        appendField(text, cellLabels_[row.cell]);
+        text += '\t';
+        text += eventName(row.event);
+        text += '\t' + std::to_string(row.refrIndexJson) + '\t';
+        appendField(text, row.idJson);
+        text += '\t' + std::to_string(row.refrIndexDb) + '\t';
+        appendField(text, row.idDb);
+        text += '\n';
+    }
+
+    std::ofstream reportFile(reportPath, std::ios::binary | std::ios::trunc);
+    reportFile.write(text.data(), static_cast<std::streamsize>(text.size()));
+    if (!reportFile.flush()) {
+        logError(logFile, "failed to write replacement report: {}", reportPath.string());
+        return false;
+    }
+
+    for (size_t cell = 0; cell < cellLabels_.size(); ++cell) {
+        logInfo(logFile, "Cell {}: {} replaced, {} mismatched", cellLabels_[cell], cellCounts[cell].first, cellCounts[cell].second);
+    }
+    logInfo(logFile, "Total: {} replaced, {} mismatched in {} cells", replaced, mismatched, cellLabels_.size());
+    logInfo(logFile, "Replacement report saved as: {}", reportPath.string());
+
+    return true;
+}
+
+// Function to get the path of the .TSV report of a plugin
+std::filesystem::path replacementReportPath(const std::filesystem::path& pluginPath) {
+    std::filesystem::path reportPath = pluginPath;
+    reportPath += ".ri_report.tsv";
+    return reportPath;
+}
@@ -0,0 +1,105 @@
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+
+#include "ri_conversion_session.h"
+#include "ri_run_report.h"
+
+namespace {
+    // Names of the timed steps in the report, in TimedStep order
+    constexpr std::array<const char*, static_cast<size_t>(TimedStep::Count)> stepNames = {
+        "prescan", "decode", "parse", "lookup", "mismatches", "serialize", "encode", "commit", "queued"
+    };
+
+    // Function to round seconds to microseconds, so the report does not show clock noise
+    double roundSeconds(double seconds) {
+        return std::round(seconds * 1e6) / 1e6;
+    }
+}
+
+StepTimer::StepTimer(FileMetrics& metrics, TimedStep step)
+    : metrics_(metrics), step_(step), outer_(metrics.activeTimer), start_(Clock::now()) {
+    // Pause the outer timer
+    if (outer_) {
+        metrics_.stepSeconds[static_cast<size_t>(outer_->step_)] += std::chrono::duration<double>(start_ - outer_->start_).count();
+    }
+    metrics_.activeTimer = this;
+}
+
+StepTimer::~StepTimer() {
+    const auto end = Clock::now();
+    metrics_.stepSeconds[static_cast<size_t>(step_)] += std::chrono::duration<double>(end - start_).count();
+
+    // Resume the outer timer
+    metrics_.activeTimer = outer_;
+    if (outer_) outer_->start_ = end;
+}
+
+void RunReport::addFile(const ConversionSession& session) {
+    const FileMetrics& metrics = session.metrics;
+
+    ordered_json steps = ordered_json::object();
+    for (size_t step = 0; step < stepNames.size(); ++step) {
+        steps[stepNames[step]] = roundSeconds(metrics.stepSeconds[step]);
+    }
+
+    ordered_json file = {
+        {"path", session.pluginPath.string()},
+        {"converted", metrics.converted},
+        {"seconds", roundSeconds(metrics.totalSeconds)},
+        {"steps", std::move(steps)},
+        {"bytes", { {"input", metrics.inputBytes}, {"json", metrics.jsonBytes}, {"output", metrics.outputBytes} }},
+        {"references", metrics.references},
+        {"queries", metrics.queries},
+        {"replacements", session.replacements},
+        {"mismatches", session.mismatches}
+    };
+    if (!metrics.converted && metrics.stoppedIn) {
+        file["stopped_in"] = metrics.stoppedIn;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    files_.push_back(std::move(file));
+}
+
+bool RunReport::write(const std::filesystem::path& reportPath, const ProgramOptions& options, double totalSeconds,
+    LogSink& logFile) const {
+    ordered_json report = {
+        {"version", PROGRAM_VERSION},
+        {"conversion", options.conversionType == 1 ? "RU->EN" : "EN->RU"},
+        {"jobs", options.jobs},
+        {"pipeline", options.pipeline},
+        {"lookups", options.preloadDb ? "memory" : "sqlite"},
+        {"seconds", roundSeconds(totalSeconds)}
+    };
+
+    // Totals of each step over all files
+    ordered_json stepTotals = ordered_json::object();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (size_t step = 0; step < stepNames.size(); ++step) {
+            double seconds = 0;
+            for (const auto& file : files_) seconds += file["steps"][stepNames[step]].get<double>();
+            stepTotals[stepNames[step]] = roundSeconds(seconds);
+        }
+
+        report["steps"] = std::move(stepTotals);
+        report["files"] = files_;
+    }
+
+    // Workers finish files in any order
+    auto& files = report["files"];
+    std::stable_sort(files.begin(), files.end(), [](const ordered_json& a, const ordered_json& b) {
+        return a["path"].get_ref<const std::string&>() < b["path"].get_ref<const std::string&>();
+        });
+
+    std::ofstream reportFile(reportPath, std::ios::trunc);
+    reportFile << report.dump(2, ' ', false, ordered_json::error_handler_t::replace) << '\n';
+    if (!reportFile.flush()) {
+        logError(logFile, "failed to write run report: {}", reportPath.string());
+        return false;
+    }
+
+    logInfo(logFile, "Run report saved as: {}", reportPath.string());
+    return true;
+}
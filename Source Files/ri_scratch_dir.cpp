@@ -0,0 +1,52 @@
+#include <atomic>
+#include <string>
+#include <system_error>
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "ri_scratch_dir.h"
+
+namespace {
+    unsigned long processId() {
+#ifdef _WIN32
+        return static_cast<unsigned long>(_getpid());
+#else
+        return static_cast<unsigned long>(getpid());
+#endif
+    }
+}
+
+ScratchDirectory::ScratchDirectory() {
+    static std::atomic<unsigned> nextId{ 0 };
+
+    // The system temp directory (TMPDIR on POSIX, TMP/TEMP on Windows). The .JSON files are several times the size
+    // of the plugin, so they are not put in memory-backed /dev/shm, which is often small and not charged to the budget
+    const std::filesystem::path base = std::filesystem::temp_directory_path();
+    const std::string prefix = "tes3_ri_" + std::to_string(processId()) + "_";
+
+    // Leftovers of an earlier process with the same id are never reused
+    for (int attempt = 0; attempt < 1000; ++attempt) {
+        std::filesystem::path candidate = base / (prefix + std::to_string(nextId++));
+        std::error_code ec;
+        if (std::filesystem::create_directory(candidate, ec)) {
+            std::filesystem::permissions(candidate, std::filesystem::perms::owner_all,
+                std::filesystem::perm_options::replace, ec);
+            path_ = std::move(candidate);
+            return;
+        }
+        if (ec) {
+            throw std::runtime_error("failed to create scratch directory " + candidate.string() + ": " + ec.message());
+        }
+    }
+
+    throw std::runtime_error("failed to create scratch directory in: " + base.string());
+}
+
+ScratchDirectory::~ScratchDirectory() {
+    std::error_code ec;
+    std::filesystem::remove_all(path_, ec);
+}
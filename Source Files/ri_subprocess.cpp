@@ -0,0 +1,333 @@
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char** environ;
+#endif
+
+#include "ri_subprocess.h"
+
+namespace {
+    constexpr size_t MAX_ERROR_OUTPUT = 64 * 1024;
+
+    // Slots for running children, shared by all threads
+    std::mutex slotMutex;
+    std::condition_variable slotReleased;
+    unsigned slotLimit = 0;
+    unsigned slotsInUse = 0;
+
+    void acquireSlot() {
+        std::unique_lock<std::mutex> lock(slotMutex);
+        slotReleased.wait(lock, [] { return slotLimit == 0 || slotsInUse < slotLimit; });
+        ++slotsInUse;
+    }
+
+    void releaseSlot() {
+        {
+            std::lock_guard<std::mutex> lock(slotMutex);
+            --slotsInUse;
+        }
+        slotReleased.notify_one();
+    }
+
+    // Append captured output up to the size limit
+    void appendErrorOutput(std::string& errorOutput, const char* data, size_t size) {
+        if (errorOutput.size() < MAX_ERROR_OUTPUT) {
+            errorOutput.append(data, std::min(size, MAX_ERROR_OUTPUT - errorOutput.size()));
+        }
+    }
+
+#ifdef _WIN32
+    // Quote a single argument for the command line, following the CommandLineToArgvW rules
+    std::wstring quoteArgument(const std::wstring& argument) {
+        if (!argument.empty() && argument.find_first_of(L" \t\n\v\"") == std::wstring::npos) {
+            return argument;
+        }
+
+        std::wstring quoted = L"\"";
+        size_t backslashes = 0;
+        for (const wchar_t c : argument) {
+            if (c == L'\\') {
+                ++backslashes;
+                continue;
+            }
+            // Backslashes are literal unless they precede a quote
+            quoted.append(c == L'"' ? backslashes * 2 + 1 : backslashes, L'\\');
+            quoted += c;
+            backslashes = 0;
+        }
+        quoted.append(backslashes * 2, L'\\');
+        quoted += L'"';
+        return quoted;
+    }
+#endif
+}
+
+void Subprocess::setLimit(unsigned limit) {
+    {
+        std::lock_guard<std::mutex> lock(slotMutex);
+        slotLimit = limit;
+    }
+    slotReleased.notify_all();
+}
+
+#ifdef _WIN32
+Subprocess::Subprocess(const std::filesystem::path& program, const std::vector<std::filesystem::path>& arguments) {
+    std::wstring commandLine = quoteArgument(program.wstring());
+    for (const auto& argument : arguments) {
+        commandLine += L' ';
+        commandLine += quoteArgument(argument.wstring());
+    }
+
+    {
+        TraceSpan slotSpan("process", "wait for process slot", arguments.empty() ? program : arguments.front());
+        acquireSlot();
+    }
+
+    // Only the three standard handles are inherited, so children started by other threads do not keep this pipe open
+    SECURITY_ATTRIBUTES inheritable{ sizeof(SECURITY_ATTRIBUTES), nullptr, TRUE };
+    HANDLE readPipe = nullptr;
+    HANDLE writePipe = nullptr;
+    HANDLE input = CreateFileW(L"NUL", GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, &inheritable, OPEN_EXISTING, 0, nullptr);
+    HANDLE output = nullptr;
+    if (!DuplicateHandle(GetCurrentProcess(), GetStdHandle(STD_OUTPUT_HANDLE), GetCurrentProcess(), &output, 0, TRUE, DUPLICATE_SAME_ACCESS)) {
+        output = CreateFileW(L"NUL", GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, &inheritable, OPEN_EXISTING, 0, nullptr);
+    }
+
+    auto closeHandles = [&]() {
+        for (HANDLE handle : { readPipe, writePipe, input, output }) {
+            if (handle && handle != INVALID_HANDLE_VALUE) CloseHandle(handle);
+        }
+        };
+
+    if (!CreatePipe(&readPipe, &writePipe, &inheritable, 0) || !SetHandleInformation(readPipe, HANDLE_FLAG_INHERIT, 0) ||
+        input == INVALID_HANDLE_VALUE || output == INVALID_HANDLE_VALUE) {
+        closeHandles();
+        releaseSlot();
+        throw std::runtime_error("failed to create pipes for: " + program.string());
+    }
+
+    HANDLE inheritedHandles[] = { input, output, writePipe };
+    SIZE_T attributeSize = 0;
+    InitializeProcThreadAttributeList(nullptr, 1, 0, &attributeSize);
+    std::vector<char> attributeBuffer(attributeSize);
+    auto attributes = reinterpret_cast<LPPROC_THREAD_ATTRIBUTE_LIST>(attributeBuffer.data());
+
+    STARTUPINFOEXW startupInfo{};
+    startupInfo.StartupInfo.cb = sizeof(startupInfo);
+    startupInfo.StartupInfo.dwFlags = STARTF_USESTDHANDLES;
+    startupInfo.StartupInfo.hStdInput = input;
+    startupInfo.StartupInfo.hStdOutput = output;
+    startupInfo.StartupInfo.hStdError = writePipe;
+    startupInfo.lpAttributeList = attributes;
+
+    PROCESS_INFORMATION processInfo{};
+    const bool initialized = InitializeProcThreadAttributeList(attributes, 1, 0, &attributeSize);
+    const bool started = initialized &&
+        UpdateProcThreadAttribute(attributes, 0, PROC_THREAD_ATTRIBUTE_HANDLE_LIST, inheritedHandles, sizeof(inheritedHandles), nullptr, nullptr) &&
+        CreateProcessW(program.c_str(), commandLine.data(), nullptr, nullptr, TRUE, EXTENDED_STARTUPINFO_PRESENT,
+            nullptr, nullptr, &startupInfo.StartupInfo, &processInfo);
+    const DWORD error = GetLastError();
+    if (initialized) DeleteProcThreadAttributeList(attributes);
+
+    // The child holds its own copies now
+    HANDLE errorPipe = readPipe;
+    readPipe = nullptr;
+    closeHandles();
+
+    if (!started) {
+        CloseHandle(errorPipe);
+        releaseSlot();
+        throw std::runtime_error("failed to start " + program.string() + " (error " + std::to_string(error) + ")");
+    }
+
+    CloseHandle(processInfo.hThread);
+    process_ = processInfo.hProcess;
+    errorPipe_ = errorPipe;
+    lifetime_.emplace("process", program.filename().string(), arguments.empty() ? program : arguments.front());
+}
+
+Subprocess::~Subprocess() {
+    if (!finished_) {
+        terminate();
+        releaseSlot();
+    }
+    if (errorPipe_) CloseHandle(errorPipe_);
+    if (process_) CloseHandle(process_);
+}
+
+void Subprocess::terminate() noexcept {
+    TerminateProcess(process_, 1);
+    WaitForSingleObject(process_, INFINITE);
+}
+
+ProcessResult Subprocess::wait(std::chrono::milliseconds timeout) {
+    if (finished_) throw std::logic_error("process was already waited for");
+
+    ProcessResult result;
+
+    // Reads block, so stderr is drained on a separate thread until the child closes it
+    std::thread reader([&]() {
+        char buffer[4096];
+        DWORD bytesRead = 0;
+        while (ReadFile(errorPipe_, buffer, sizeof(buffer), &bytesRead, nullptr) && bytesRead != 0) {
+            appendErrorOutput(result.errorOutput, buffer, bytesRead);
+        }
+        });
+
+    const DWORD waitTime = timeout.count() > 0 ? static_cast<DWORD>(timeout.count()) : INFINITE;
+    if (WaitForSingleObject(process_, waitTime) == WAIT_TIMEOUT) {
+        result.timedOut = true;
+        terminate();
+    }
+    reader.join();
+
+    DWORD exitCode = 0;
+    if (!result.timedOut && GetExitCodeProcess(process_, &exitCode)) {
+        result.exitCode = static_cast<int>(exitCode);
+    }
+
+    finished_ = true;
+    lifetime_.reset();
+    releaseSlot();
+    return result;
+}
+#else
+Subprocess::Subprocess(const std::filesystem::path& program, const std::vector<std::filesystem::path>& arguments) {
+    std::vector<char*> argv;
+    argv.push_back(const_cast<char*>(program.c_str()));
+    for (const auto& argument : arguments) {
+        argv.push_back(const_cast<char*>(argument.c_str()));
+    }
+    argv.push_back(nullptr);
+
+    {
+        TraceSpan slotSpan("process", "wait for process slot", arguments.empty() ? program : arguments.front());
+        acquireSlot();
+    }
+
+    // Close-on-exec keeps the pipe out of children started by other threads, dup2 clears it for the stderr copy
+    int pipeFds[2];
+    if (pipe2(pipeFds, O_CLOEXEC) != 0) {
+        releaseSlot();
+        throw std::runtime_error("failed to create pipe for " + program.string() + ": " + std::strerror(errno));
+    }
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, "/dev/null", O_RDONLY, 0);
+    posix_spawn_file_actions_adddup2(&actions, pipeFds[1], STDERR_FILENO);
+
+    pid_t pid = -1;
+    const int error = posix_spawn(&pid, program.c_str(), &actions, nullptr, argv.data(), environ);
+    posix_spawn_file_actions_destroy(&actions);
+    close(pipeFds[1]);
+
+    if (error != 0) {
+        close(pipeFds[0]);
+        releaseSlot();
+        throw std::runtime_error("failed to start " + program.string() + ": " + std::strerror(error));
+    }
+
+    pid_ = pid;
+    errorPipe_ = pipeFds[0];
+    lifetime_.emplace("process", program.filename().string(), arguments.empty() ? program : arguments.front());
+}
+
+Subprocess::~Subprocess() {
+    if (!finished_) {
+        terminate();
+        releaseSlot();
+    }
+    if (errorPipe_ != -1) close(errorPipe_);
+}
+
+void Subprocess::terminate() noexcept {
+    kill(pid_, SIGKILL);
+    while (waitpid(pid_, nullptr, 0) == -1 && errno == EINTR) {}
+}
+
+ProcessResult Subprocess::wait(std::chrono::milliseconds timeout) {
+    if (finished_) throw std::logic_error("process was already waited for");
+
+    using Clock = std::chrono::steady_clock;
+    const auto deadline = Clock::now() + timeout;
+    const bool hasTimeout = timeout.count() > 0;
+
+    // Milliseconds left until the deadline, -1 - no timeout
+    auto remaining = [&]() -> int {
+        if (!hasTimeout) return -1;
+        const auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - Clock::now()).count();
+        return left > 0 ? static_cast<int>(left) : 0;
+        };
+
+    ProcessResult result;
+
+    // Drain stderr until the child closes it
+    char buffer[4096];
+    while (errorPipe_ != -1) {
+        pollfd descriptor{ errorPipe_, POLLIN, 0 };
+        const int ready = poll(&descriptor, 1, remaining());
+        if (ready == -1 && errno == EINTR) continue;
+        if (ready == 0) {
+            result.timedOut = true;
+            break;
+        }
+
+        const ssize_t bytesRead = read(errorPipe_, buffer, sizeof(buffer));
+        if (bytesRead > 0) {
+            appendErrorOutput(result.errorOutput, buffer, static_cast<size_t>(bytesRead));
+        }
+        else if (bytesRead == 0 || errno != EINTR) {
+            close(errorPipe_);
+            errorPipe_ = -1;
+        }
+    }
+
+    // Reap the child, polling while a deadline applies
+    int status = 0;
+    while (!result.timedOut) {
+        const pid_t reaped = waitpid(pid_, &status, hasTimeout ? WNOHANG : 0);
+        if (reaped == pid_) break;
+        if (reaped == -1 && errno != EINTR) {
+            status = -1;
+            break;
+        }
+        if (reaped == 0) {
+            if (remaining() == 0) {
+                result.timedOut = true;
+                break;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+    }
+
+    if (result.timedOut) {
+        terminate();
+    }
+    else if (status != -1 && WIFEXITED(status)) {
+        result.exitCode = WEXITSTATUS(status);
+    }
+
+    finished_ = true;
+    lifetime_.reset();
+    releaseSlot();
+    return result;
+}
+#endif
@@ -0,0 +1,93 @@
+#include <atomic>
+#include <fstream>
+#include <mutex>
+#include <vector>
+
+#include "ri_options.h"
+#include "ri_trace.h"
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    // Finished span, times in microseconds since tracing was enabled
+    struct TraceEvent {
+        std::string category;
+        std::string name;
+        std::string file;
+        long long start;
+        long long duration;
+        unsigned thread;
+    };
+
+    // Events of all threads, shared like the process slots of Subprocess
+    std::atomic<bool> tracingEnabled = false;
+    Clock::time_point traceStart;
+    std::mutex traceMutex;
+    std::vector<TraceEvent> traceEvents;
+
+    // Small sequential thread IDs in order of the first recorded span, so the viewer lists the threads in a stable order
+    unsigned currentThreadId() {
+        static std::atomic<unsigned> nextThreadId = 1;
+        thread_local const unsigned threadId = nextThreadId++;
+        return threadId;
+    }
+
+    long long microseconds(Clock::duration duration) {
+        return std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+    }
+}
+
+// Function to start recording trace events, spans created before are not recorded
+void enableTracing() {
+    traceStart = Clock::now();
+    tracingEnabled = true;
+}
+
+// Function to write the recorded events in Chrome trace-event format, for chrome://tracing or Perfetto
+bool writeTrace(const std::filesystem::path& tracePath, LogSink& logFile) {
+    ordered_json events = ordered_json::array();
+    {
+        std::lock_guard<std::mutex> lock(traceMutex);
+        for (const TraceEvent& event : traceEvents) {
+            ordered_json entry = {
+                {"name", event.name}, {"cat", event.category}, {"ph", "X"},
+                {"ts", event.start}, {"dur", event.duration}, {"pid", 1}, {"tid", event.thread}
+            };
+            if (!event.file.empty()) entry["args"] = { {"file", event.file} };
+            events.push_back(std::move(entry));
+        }
+    }
+
+    const ordered_json trace = { {"traceEvents", std::move(events)}, {"displayTimeUnit", "ms"} };
+
+    std::ofstream traceFile(tracePath, std::ios::trunc);
+    traceFile << trace.dump(-1, ' ', false, ordered_json::error_handler_t::replace) << '\n';
+    if (!traceFile.flush()) {
+        logError(logFile, "failed to write trace: {}", tracePath.string());
+        return false;
+    }
+
+    logInfo(logFile, "Trace saved as: {}", tracePath.string());
+    return true;
+}
+
+TraceSpan::TraceSpan(std::string_view category, std::string_view name, const std::filesystem::path& file) {
+    if (!tracingEnabled) return;
+
+    active_ = true;
+    category_ = category;
+    name_ = name;
+    file_ = file.string();
+    start_ = Clock::now();
+}
+
+TraceSpan::~TraceSpan() {
+    if (!active_) return;
+
+    const auto end = Clock::now();
+    TraceEvent event{ std::move(category_), std::move(name_), std::move(file_),
+        microseconds(start_ - traceStart), microseconds(end - start_), currentThreadId() };
+
+    std::lock_guard<std::mutex> lock(traceMutex);
+    traceEvents.push_back(std::move(event));
+}
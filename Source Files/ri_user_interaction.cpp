@@ -12,10 +12,13 @@
 // Unified function for handling user choices
 int getUserChoice(const std::string& prompt,
     const std::unordered_set<std::string>& validChoices,
-    std::ofstream& logFile)
+    LogSink& logFile)
 {
     const std::string errorMessage = "\nInvalid choice: enter ";
     std::string input;
+    // Show everything logged so far before the prompt
+    logFile.flush();
+
     while (true) {
         std::cout << prompt;
         std::getline(std::cin, input);
@@ -35,7 +38,7 @@ int getUserChoice(const std::string& prompt,
 }
 
 // Function for handling user conversion choices
-int getUserConversionChoice(std::ofstream& logFile) {
+int getUserConversionChoice(LogSink& logFile) {
     return getUserChoice(
         "\nConvert refr_index values in a plugin or master file:\n"
         "1. From Russian 1C to English GOTY\n"
@@ -46,7 +49,7 @@ int getUserConversionChoice(std::ofstream& logFile) {
 }
 
 // Function for handling user mismatch choices
-int getUserMismatchChoice(std::ofstream& logFile, const ProgramOptions& options) {
+int getUserMismatchChoice(LogSink& logFile, const ProgramOptions& options) {
     if (options.batchMode) {
         if (!options.silentMode) {
             logMessage("\nBatch mode enabled - automatically replacing mismatched entries...\n", logFile);
@@ -69,7 +72,7 @@ int getUserMismatchChoice(std::ofstream& logFile, const ProgramOptions& options)
 }
 
 // Function for handling input file paths from user with recursive directory search
-std::vector<std::filesystem::path> getInputFilePaths(const ProgramOptions& options, std::ofstream& logFile) {
+std::vector<std::filesystem::path> getInputFilePaths(const ProgramOptions& options, LogSink& logFile) {
     std::vector<std::filesystem::path> result;
 
     // Helper function to normalize a string path: remove quotes and trim whitespace
@@ -152,6 +155,9 @@ std::vector<std::filesystem::path> getInputFilePaths(const ProgramOptions& optio
         return pathStrings;
         };
 
+    // Show everything logged so far before the prompts
+    logFile.flush();
+
     // Batch (interactive multi-path) mode
     if (options.batchMode) {
         while (true) {
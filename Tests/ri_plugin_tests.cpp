@@ -0,0 +1,253 @@
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "ri_file_processor.h"
+#include "ri_logger.h"
+#include "ri_options.h"
+#include "ri_plugin_patcher.h"
+#include "ri_plugin_reader.h"
+#include "ri_subprocess.h"
+
+// Checks of the native plugin reader and patcher on a small fixture plugin (Fixtures/refr_index_fixture.esp):
+// a header with the three masters, a static, an interior cell and an exterior cell with a moved reference.
+//
+// Usage: ri_plugin_tests native <fixture> <work directory>
+//        ri_plugin_tests tes3conv <fixture> <work directory> <tes3conv>
+//
+// "native" patches the fixture and reads the result back. "tes3conv" compares the reader with the .JSON of tes3conv
+// and the patched plugin with the one re-encoded by tes3conv; it is skipped when no tes3conv is given
+
+namespace {
+    constexpr int TEST_SKIPPED = 77;
+    const std::string CONVERSION_PREFIX = "EN->RU";
+
+    int failures = 0;
+
+    // Function to report a failed check
+    void check(bool condition, const std::string& message) {
+        if (!condition) {
+            std::cerr << "FAILED - " << message << "\n";
+            ++failures;
+        }
+    }
+
+    // Function to read a whole file as bytes
+    std::string readBytes(const std::filesystem::path& path) {
+        std::ifstream file(path, std::ios::binary);
+        return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+
+    // Function to keep the Header and Cell records with the members the converter uses, in file order
+    ordered_json converterView(const ordered_json& pluginData) {
+        ordered_json view = ordered_json::array();
+        for (const auto& record : pluginData) {
+            const std::string type = record.value("type", "");
+            if (type == "Header") {
+                view.push_back({ {"type", type}, {"description", record["description"]}, {"masters", record["masters"]} });
+            }
+            else if (type == "Cell") {
+                ordered_json references = ordered_json::array();
+                for (const auto& reference : record["references"]) {
+                    references.push_back({ {"mast_index", reference["mast_index"]}, {"refr_index", reference["refr_index"]},
+                                           {"id", reference["id"]} });
+                }
+                view.push_back({ {"type", type}, {"id", record["id"]}, {"grid", record["data"]["grid"]},
+                                 {"references", std::move(references)} });
+            }
+        }
+        return view;
+    }
+
+    // Function to change the refr_index of every reference from a master, the same way in any plugin data
+    void shiftRefrIndices(ordered_json& pluginData) {
+        for (auto& record : pluginData) {
+            if (record.value("type", "") != "Cell") continue;
+
+            for (auto& reference : record["references"]) {
+                if (reference["mast_index"].get<int>() == 0) continue;
+                reference["refr_index"] = (reference["refr_index"].get<int>() + 100000) & 0x00FFFFFF;
+            }
+        }
+    }
+
+    // Function to make the same changes as a conversion: new refr_index values and the conversion tag
+    bool convert(ordered_json& pluginData, const ProgramOptions& options, LogSink& logFile) {
+        shiftRefrIndices(pluginData);
+        return addConversionTag(pluginData, CONVERSION_PREFIX, options, logFile);
+    }
+
+    // Function to run tes3conv on the input file to produce the output file
+    bool runTes3conv(const std::filesystem::path& tes3conv, const std::filesystem::path& inputPath,
+        const std::filesystem::path& outputPath) {
+        try {
+            Subprocess process(tes3conv, { inputPath, outputPath });
+            const ProcessResult result = process.wait();
+            if (result.exitCode != 0) std::cerr << "tes3conv: " << result.errorOutput << "\n";
+            return result.exitCode == 0;
+        }
+        catch (const std::exception& e) {
+            std::cerr << "ERROR - " << e.what() << "\n";
+            return false;
+        }
+    }
+
+    // Function to check that the offsets kept by the reader point at the values they describe
+    void checkOffsets(const ordered_json& pluginData, const std::string& plugin) {
+        auto readU32At = [&](size_t offset) {
+            uint32_t value = 0;
+            if (offset + sizeof(value) <= plugin.size()) std::memcpy(&value, plugin.data() + offset, sizeof(value));
+            return value;
+        };
+
+        size_t movedReferences = 0;
+        for (const auto& record : pluginData) {
+            if (record["type"] == "Header") {
+                const size_t offset = record["description_offset"];
+                check(plugin.compare(offset - 40 - 8, 4, "HEDR") == 0, "description_offset is not inside HEDR");
+            }
+            if (record["type"] != "Cell") continue;
+
+            for (const auto& reference : record["references"]) {
+                const uint32_t frmr = (reference["mast_index"].get<uint32_t>() << 24) | reference["refr_index"].get<uint32_t>();
+                const size_t frmrOffset = reference["frmr_offset"];
+                check(plugin.compare(frmrOffset - 8, 4, "FRMR") == 0 && readU32At(frmrOffset) == frmr,
+                    "frmr_offset does not point at the FRMR value of " + reference["id"].get<std::string>());
+
+                if (reference.contains("mvrf_offset")) {
+                    const size_t mvrfOffset = reference["mvrf_offset"];
+                    check(plugin.compare(mvrfOffset - 8, 4, "MVRF") == 0 && readU32At(mvrfOffset) == frmr,
+                        "mvrf_offset does not point at the MVRF value of " + reference["id"].get<std::string>());
+                    ++movedReferences;
+                }
+            }
+        }
+        check(movedReferences == 1, "expected 1 moved reference, found " + std::to_string(movedReferences));
+    }
+
+    // Patch the fixture natively and read the result back: only the FRMR, MVRF and description bytes may change
+    int testNativeRoundTrip(const std::filesystem::path& fixturePath, const std::filesystem::path& workDir,
+        const ProgramOptions& options, LogSink& logFile) {
+        auto pluginData = readPluginFile(fixturePath, logFile);
+        if (!pluginData) {
+            std::cerr << "FAILED - native read of " << fixturePath.string() << "\n";
+            return 1;
+        }
+
+        const std::string original = readBytes(fixturePath);
+        checkOffsets(*pluginData, original);
+        check(converterView(*pluginData).size() == 3, "expected a header and two cells");
+
+        check(convert(*pluginData, options, logFile), "could not add the conversion tag");
+        const std::filesystem::path patchedPath = workDir / "native_patched.esp";
+        check(patchPluginFile(fixturePath, patchedPath, *pluginData, CONVERSION_PREFIX, options, logFile), "native patch failed");
+
+        const auto patchedData = readPluginFile(patchedPath, logFile);
+        check(patchedData && converterView(*patchedData) == converterView(*pluginData),
+            "patched plugin does not read back as the converted data");
+
+        // Every changed byte lies in a patched field
+        std::vector<std::pair<size_t, size_t>> fields;
+        for (const auto& record : *pluginData) {
+            if (record["type"] == "Header") fields.emplace_back(record["description_offset"].get<size_t>(), 256);
+            if (record["type"] != "Cell") continue;
+            for (const auto& reference : record["references"]) {
+                fields.emplace_back(reference["frmr_offset"].get<size_t>(), 4);
+                if (reference.contains("mvrf_offset")) fields.emplace_back(reference["mvrf_offset"].get<size_t>(), 4);
+            }
+        }
+
+        const std::string patched = readBytes(patchedPath);
+        check(patched.size() == original.size(), "patched plugin changed its size");
+        for (size_t i = 0; i < std::min(patched.size(), original.size()); ++i) {
+            if (patched[i] == original[i]) continue;
+
+            bool inField = false;
+            for (const auto& [offset, size] : fields) inField = inField || (i >= offset && i < offset + size);
+            check(inField, "byte " + std::to_string(i) + " changed outside the patched fields");
+            if (!inField) break;
+        }
+
+        return failures == 0 ? 0 : 1;
+    }
+
+    // Compare the native reader with tes3conv .JSON and the native patch with the tes3conv re-encode, byte for byte
+    int testTes3convParity(const std::filesystem::path& fixturePath, const std::filesystem::path& workDir,
+        const std::filesystem::path& tes3conv, const ProgramOptions& options, LogSink& logFile) {
+        const std::filesystem::path jsonPath = workDir / "fixture.json";
+        const std::filesystem::path convertedJsonPath = workDir / "fixture_converted.json";
+        const std::filesystem::path tes3convPath = workDir / "tes3conv_converted.esp";
+        const std::filesystem::path patchedPath = workDir / "native_converted.esp";
+
+        if (!runTes3conv(tes3conv, fixturePath, jsonPath)) {
+            std::cerr << "FAILED - tes3conv could not convert the fixture to .JSON\n";
+            return 1;
+        }
+
+        auto jsonData = loadJsonFile(jsonPath, options, logFile);
+        auto pluginData = readPluginFile(fixturePath, logFile);
+        if (!jsonData || !pluginData) {
+            std::cerr << "FAILED - reading the fixture\n";
+            return 1;
+        }
+
+        const ordered_json nativeView = converterView(*pluginData);
+        const ordered_json jsonView = converterView(*jsonData);
+        check(nativeView == jsonView, "native read differs from tes3conv .JSON:\n" + nativeView.dump(2) + "\n" + jsonView.dump(2));
+
+        // The same conversion on both paths: tes3conv re-encodes the .JSON, the native path patches the bytes
+        check(convert(*jsonData, options, logFile) && convert(*pluginData, options, logFile), "could not add the conversion tag");
+        check(saveJsonToFile(convertedJsonPath, *jsonData, options, logFile) && runTes3conv(tes3conv, convertedJsonPath, tes3convPath),
+            "tes3conv could not convert the .JSON back to .ESP");
+        check(patchPluginFile(fixturePath, patchedPath, *pluginData, CONVERSION_PREFIX, options, logFile), "native patch failed");
+
+        const std::string expected = readBytes(tes3convPath);
+        const std::string patched = readBytes(patchedPath);
+        if (expected != patched) {
+            size_t position = 0;
+            while (position < expected.size() && position < patched.size() && expected[position] == patched[position]) ++position;
+            check(false, "native patch differs from the tes3conv re-encode at byte " + std::to_string(position));
+        }
+
+        return failures == 0 ? 0 : 1;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 4) {
+        std::cerr << "Usage: ri_plugin_tests native|tes3conv <fixture> <work directory> [tes3conv]\n";
+        return 2;
+    }
+
+    const std::string test = argv[1];
+    const std::filesystem::path fixturePath = argv[2];
+    const std::filesystem::path workDir = argv[3];
+    std::filesystem::create_directories(workDir);
+
+    std::ofstream logStream(workDir / (test + ".log"), std::ios::trunc);
+    LogSink logFile(logStream, false, LogLevel::Error);
+    ProgramOptions options;
+    options.silentMode = true;
+
+    int result = 2;
+    if (test == "native") {
+        result = testNativeRoundTrip(fixturePath, workDir, options, logFile);
+    }
+    else if (test == "tes3conv") {
+        if (argc < 5 || std::string(argv[4]).empty() || !std::filesystem::exists(argv[4])) {
+            std::cout << "tes3conv not found - comparison skipped\n";
+            return TEST_SKIPPED;
+        }
+        result = testTes3convParity(fixturePath, workDir, argv[4], options, logFile);
+    }
+
+    logFile.flush();
+    if (result == 0) std::cout << test << ": all checks passed\n";
+    return result;
+}